@@ -0,0 +1,95 @@
+// Fan-out microbenchmark: what one broadcast to N recipients costs when every
+// recipient queue gets its own std::string copy (the old send path) versus a
+// shared MessageBuffer handle.
+//
+//   broadcast_bench [recipients] [message_bytes] [iterations]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../server/message_buffer.hpp"
+
+using namespace std;
+
+static atomic<uint64_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+struct Result {
+    double ns_per_broadcast;
+    double allocations_per_broadcast;
+    double bytes_copied_per_broadcast;
+};
+
+template <typename Queue, typename Fanout>
+Result run(size_t recipients, int iterations, Fanout fanout) {
+    vector<Queue> queues(recipients);
+    uint64_t bytes_copied = 0;
+    uint64_t allocations = 0;
+    chrono::nanoseconds elapsed{0};
+
+    for (int i = 0; i < iterations; ++i) {
+        auto before = allocation_count.load();
+        auto start = chrono::steady_clock::now();
+        bytes_copied += fanout(queues);
+        elapsed += chrono::steady_clock::now() - start;
+        allocations += allocation_count.load() - before;
+        // Drain as the writers would, outside the measured region.
+        for (auto& q : queues) q.clear();
+    }
+    return {static_cast<double>(elapsed.count()) / iterations,
+            static_cast<double>(allocations) / iterations,
+            static_cast<double>(bytes_copied) / iterations};
+}
+
+void print(const char* name, const Result& r) {
+    printf("%-16s %14.0f ns %14.1f allocs %16.0f bytes copied\n",
+           name, r.ns_per_broadcast, r.allocations_per_broadcast, r.bytes_copied_per_broadcast);
+}
+
+int main(int argc, char* argv[]) {
+    size_t recipients = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+    size_t message_bytes = argc > 2 ? strtoul(argv[2], nullptr, 10) : 256;
+    int iterations = argc > 3 ? atoi(argv[3]) : 200;
+
+    const string text(message_bytes, 'x');
+    printf("%zu recipients, %zu-byte message, %d iterations (per broadcast):\n",
+           recipients, message_bytes, iterations);
+
+    auto per_copy = run<deque<string>>(recipients, iterations, [&](vector<deque<string>>& queues) {
+        const string message = text;  // built once by the caller
+        uint64_t copied = message.size();
+        for (auto& q : queues) {
+            q.push_back(message);
+            copied += message.size();
+        }
+        return copied;
+    });
+
+    auto shared = run<deque<MessageBuffer>>(recipients, iterations, [&](vector<deque<MessageBuffer>>& queues) {
+        auto message = MessageBuffer::make(text);
+        for (auto& q : queues) q.push_back(message);
+        return static_cast<uint64_t>(message.size());
+    });
+
+    print("string copy", per_copy);
+    print("MessageBuffer", shared);
+
+    auto stats = MessageBuffer::pool_stats();
+    printf("MessageBuffer pool: %llu pooled, %llu heap allocations\n",
+           static_cast<unsigned long long>(stats.pooled_allocations),
+           static_cast<unsigned long long>(stats.heap_allocations));
+    return 0;
+}
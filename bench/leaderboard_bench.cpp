@@ -0,0 +1,99 @@
+// Leaderboard at scale: a stream of match results interleaved with
+// /leaderboard and /rank queries, answered by sorting every player on demand
+// (what the status dump would take) and by the indexed Leaderboard.
+//
+//   leaderboard_bench [players] [operations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../server/leaderboard.hpp"
+
+using namespace std;
+
+struct Stats {
+    int played = 0;
+    int won = 0;
+};
+
+static bool better(const Stats& a, int ida, const Stats& b, int idb) {
+    double ra = a.played ? static_cast<double>(a.won) / a.played : 0.0;
+    double rb = b.played ? static_cast<double>(b.won) / b.played : 0.0;
+    if (ra != rb) return ra > rb;
+    if (a.won != b.won) return a.won > b.won;
+    return ida < idb;
+}
+
+int main(int argc, char* argv[]) {
+    int num_players = argc > 1 ? atoi(argv[1]) : 100000;
+    int num_ops = argc > 2 ? atoi(argv[2]) : 20000;
+
+    // 90% results, 5% top-10 queries, 5% rank queries.
+    mt19937 rng(42);
+    struct Op {
+        int kind;  // 0 result, 1 top, 2 rank
+        int a, b;
+    };
+    vector<Op> ops(num_ops);
+    for (auto& op : ops) {
+        int roll = rng() % 100;
+        op.kind = roll < 90 ? 0 : (roll < 95 ? 1 : 2);
+        op.a = rng() % num_players;
+        op.b = rng() % num_players;
+    }
+    printf("%d players, %d operations\n", num_players, num_ops);
+    printf("%-12s %14s %14s\n", "index", "ops/sec", "checksum");
+
+    {
+        vector<Stats> players(num_players);
+        vector<int> order(num_players);
+        long checksum = 0;
+        auto start = chrono::steady_clock::now();
+        for (const auto& op : ops) {
+            if (op.kind == 0) {
+                players[op.a].played++, players[op.b].played++, players[op.a].won++;
+                continue;
+            }
+            if (op.kind == 1) {
+                for (int i = 0; i < num_players; ++i) order[i] = i;
+                partial_sort(order.begin(), order.begin() + 10, order.end(),
+                             [&](int x, int y) { return better(players[x], x, players[y], y); });
+                checksum += order[0];
+            } else {
+                int rank = 1;
+                for (int i = 0; i < num_players; ++i) rank += better(players[i], i, players[op.a], op.a);
+                checksum += rank;
+            }
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%-12s %14.0f %14ld\n", "scan", num_ops / secs, checksum);
+    }
+
+    {
+        Leaderboard board;
+        vector<Stats> players(num_players);
+        for (int i = 0; i < num_players; ++i) board.update(i, "Player" + to_string(i), 0, 0);
+        long checksum = 0;
+        auto start = chrono::steady_clock::now();
+        for (const auto& op : ops) {
+            if (op.kind == 0) {
+                players[op.a].played++, players[op.b].played++, players[op.a].won++;
+                board.update(op.a, "Player" + to_string(op.a), players[op.a].played, players[op.a].won);
+                board.update(op.b, "Player" + to_string(op.b), players[op.b].played, players[op.b].won);
+            } else if (op.kind == 1) {
+                checksum += board.top(10).front().id;
+            } else {
+                checksum += board.rank(op.a);
+            }
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%-12s %14.0f %14ld   (%llu cache rebuilds)\n", "Leaderboard", num_ops / secs, checksum,
+               static_cast<unsigned long long>(board.cache_rebuilds()));
+    }
+    return 0;
+}
@@ -0,0 +1,485 @@
+// Load generator: thousands of simulated players over localhost. Bots join a
+// mode, challenge and answer at configurable rates, sometimes let a challenge
+// time out on purpose, and chat. Reports match round-trip latency (challenge
+// sent -> "Match Result" received by the challenger), message rates and the
+// server's RSS.
+//
+//   loadgen [--scenario NAME] [--bots N] [--duration S] [--server-pid PID] ...
+//
+// Scenarios set the defaults below; any flag given after them overrides:
+//   mixed             deathmatch, 1 challenge/s, light chat, 2% timeouts
+//   deathmatch-flood  deathmatch, 5 challenges/s and 1 chat/s per bot
+//   lms-storm         LMS rooms that fill, play out and re-queue continuously
+//   slow-reader       deathmatch flood plus 10% of bots that stop reading
+//                     (pair with a small server --high-water to see shedding)
+
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using boost::asio::ip::tcp;
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+struct Config {
+    string scenario = "mixed";
+    string host = "127.0.0.1";
+    unsigned short port = 12345;
+    int bots = 500;
+    int threads = max(1u, thread::hardware_concurrency());
+    int duration_s = 20;
+    string mode = "deathmatch";
+    double challenge_rate = 1.0;  // per bot per second
+    double chat_rate = 0.2;       // per bot per second
+    int timeout_pct = 2;          // share of received challenges left unanswered
+    int slow_pct = 0;             // share of bots that stop reading once joined
+    int server_pid = 0;
+};
+
+bool apply_scenario(Config& c, const string& name) {
+    c.scenario = name;
+    if (name == "mixed") {
+        c.mode = "deathmatch", c.challenge_rate = 1.0, c.chat_rate = 0.2, c.timeout_pct = 2, c.slow_pct = 0;
+    } else if (name == "deathmatch-flood") {
+        c.mode = "deathmatch", c.challenge_rate = 5.0, c.chat_rate = 1.0, c.timeout_pct = 0, c.slow_pct = 0;
+    } else if (name == "lms-storm") {
+        c.mode = "lms", c.challenge_rate = 2.0, c.chat_rate = 0.1, c.timeout_pct = 5, c.slow_pct = 0;
+    } else if (name == "slow-reader") {
+        c.mode = "deathmatch", c.challenge_rate = 2.0, c.chat_rate = 0.5, c.timeout_pct = 0, c.slow_pct = 10;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Counters shared by every bot; only the measurement window is reported.
+struct Stats {
+    atomic<bool> measuring{false};
+    atomic<int> connected{0};
+    atomic<int> joined{0};
+    atomic<int> failed{0};
+    atomic<uint64_t> lines_sent{0};
+    atomic<uint64_t> lines_received{0};
+    atomic<uint64_t> matches{0};
+    atomic<uint64_t> timeouts{0};
+    atomic<uint64_t> refused{0};
+    atomic<uint64_t> lost{0};
+    atomic<uint64_t> disconnects{0};
+
+    mutex latency_mutex;
+    vector<uint32_t> latencies_us;
+
+    void reset() {
+        for (auto* c : {&lines_sent, &lines_received, &matches, &timeouts, &refused, &lost, &disconnects}) c->store(0);
+        lock_guard<mutex> lock(latency_mutex);
+        latencies_us.clear();
+    }
+    void record_latency(Clock::duration d) {
+        if (!measuring.load(memory_order_relaxed)) return;
+        lock_guard<mutex> lock(latency_mutex);
+        latencies_us.push_back(static_cast<uint32_t>(chrono::duration_cast<chrono::microseconds>(d).count()));
+    }
+};
+
+// Which bots are in which room, so a bot can pick a challenge target.
+class RoomDirectory {
+public:
+    void add(int room, int id) {
+        lock_guard<mutex> lock(mutex_);
+        rooms_[room].push_back(id);
+    }
+    void remove(int room, int id) {
+        lock_guard<mutex> lock(mutex_);
+        auto& ids = rooms_[room];
+        auto it = find(ids.begin(), ids.end(), id);
+        if (it == ids.end()) return;
+        *it = ids.back();
+        ids.pop_back();
+    }
+    // A random member of `room` other than `self`, or -1.
+    int pick(int room, int self, mt19937& rng) {
+        lock_guard<mutex> lock(mutex_);
+        auto it = rooms_.find(room);
+        if (it == rooms_.end() || it->second.size() < 2) return -1;
+        const auto& ids = it->second;
+        for (int tries = 0; tries < 4; ++tries) {
+            int id = ids[rng() % ids.size()];
+            if (id != self) return id;
+        }
+        return -1;
+    }
+
+private:
+    mutex mutex_;
+    unordered_map<int, vector<int>> rooms_;
+};
+
+const char kMoves[] = {'R', 'P', 'S'};
+const char* const kChat[] = {"gg", "anyone up for a rematch?", "nice one", "brb", "rock is overrated"};
+constexpr auto kPendingGiveUp = chrono::seconds(15);
+
+bool starts_with(string_view s, string_view prefix) { return s.substr(0, prefix.size()) == prefix; }
+
+class Bot : public enable_shared_from_this<Bot> {
+public:
+    Bot(boost::asio::io_context& io, const Config& config, Stats& stats, RoomDirectory& directory, unsigned seed,
+        bool slow)
+        : strand_(boost::asio::make_strand(io)), socket_(strand_), timer_(strand_), config_(config),
+          stats_(stats), directory_(directory), rng_(seed), slow_(slow) {}
+
+    void start(const tcp::endpoint& endpoint) {
+        if (slow_) {
+            // A small receive window, set before connecting, so the backlog
+            // lands in the server's queue instead of the kernel's buffers.
+            socket_.open(endpoint.protocol());
+            socket_.set_option(boost::asio::socket_base::receive_buffer_size(4096));
+        }
+        socket_.async_connect(endpoint, [self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec) {
+                self->stats_.failed++;
+                return;
+            }
+            self->stats_.connected++;
+            self->socket_.set_option(tcp::no_delay(true));
+            self->do_read();
+            self->send("/mode " + self->config_.mode);
+            self->schedule_action();
+        });
+    }
+
+    void stop() {
+        boost::asio::post(strand_, [self = shared_from_this()] {
+            self->stopped_ = true;
+            self->timer_.cancel();
+            boost::system::error_code ignored;
+            self->socket_.close(ignored);
+        });
+    }
+
+private:
+    // Reads in large chunks and splits lines in place; one async op per line
+    // would make the generator, not the server, the bottleneck.
+    void do_read() {
+        socket_.async_read_some(boost::asio::buffer(chunk_),
+            [self = shared_from_this()](const boost::system::error_code& ec, size_t length) {
+                if (ec) {
+                    if (!self->stopped_) self->stats_.disconnects++;
+                    self->stopped_ = true;
+                    self->timer_.cancel();
+                    return;
+                }
+                self->inbox_.append(self->chunk_.data(), length);
+                string_view rest = self->inbox_;
+                uint64_t lines = 0;
+                for (size_t nl; (nl = rest.find('\n')) != string_view::npos;) {
+                    self->on_line(rest.substr(0, nl));
+                    rest.remove_prefix(nl + 1);
+                    lines++;
+                }
+                self->stats_.lines_received.fetch_add(lines, memory_order_relaxed);
+                self->inbox_.erase(0, self->inbox_.size() - rest.size());
+                // A slow reader goes quiet once it is in a room and lets the
+                // server's outbound queue for it fill up.
+                if (!(self->slow_ && self->room_ >= 0)) self->do_read();
+            });
+    }
+
+    void on_line(string_view line) {
+        if (starts_with(line, "You are ")) {
+            auto pos = line.find("(ID ");
+            if (pos != string_view::npos) id_ = atoi(string(line.substr(pos + 4)).c_str());
+            name_ = "Player" + to_string(id_);
+        } else if (starts_with(line, "Joined room ")) {
+            room_ = atoi(string(line.substr(12)).c_str());
+            alive_ = true;
+            started_ = config_.mode == "deathmatch";
+            if (!slow_) directory_.add(room_, id_);
+            stats_.joined++;
+        } else if (starts_with(line, "LMS: All players connected")) {
+            started_ = true;
+        } else if (starts_with(line, "Challenge: ")) {
+            if (static_cast<int>(rng_() % 100) >= config_.timeout_pct) {
+                send(string("/move ") + kMoves[rng_() % 3]);
+            }
+        } else if (starts_with(line, "Match Result: ")) {
+            if (pending_ && starts_with(line.substr(14), name_ + " ")) {
+                pending_ = false;
+                if (line.find("wins by timeout") != string_view::npos) {
+                    stats_.timeouts++;
+                } else {
+                    stats_.matches++;
+                    stats_.record_latency(Clock::now() - sent_at_);
+                }
+            }
+        } else if (pending_ && starts_with(line, pending_target_ + " lost 1 HP by timeout")) {
+            pending_ = false;
+            stats_.timeouts++;
+        } else if (starts_with(line, "Cannot challenge") || line.find("is not in your room") != string_view::npos
+                   || starts_with(line, "You can't challenge")) {
+            if (pending_) stats_.refused++;
+            pending_ = false;
+        } else if (line == name_ + " has died.") {
+            alive_ = false;
+            directory_.remove(room_, id_);
+        } else if (starts_with(line, "Game Over!")) {
+            // LMS round finished: back to the lobby and straight into the queue.
+            directory_.remove(room_, id_);
+            room_ = -1;
+            started_ = false;
+            pending_ = false;
+            send("/room leave");
+            send("/mode " + config_.mode);
+        }
+    }
+
+    void schedule_action() {
+        const double rate = config_.challenge_rate + config_.chat_rate;
+        if (stopped_ || slow_ || rate <= 0) return;
+        exponential_distribution<double> gap(rate);
+        timer_.expires_after(chrono::microseconds(static_cast<int64_t>(gap(rng_) * 1e6)));
+        timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec || self->stopped_) return;
+            self->act();
+            self->schedule_action();
+        });
+    }
+
+    void act() {
+        if (pending_ && Clock::now() - sent_at_ > kPendingGiveUp) {
+            pending_ = false;
+            stats_.lost++;
+        }
+        uniform_real_distribution<double> u(0, config_.challenge_rate + config_.chat_rate);
+        if (u(rng_) < config_.chat_rate) {
+            send(kChat[rng_() % size(kChat)]);
+            return;
+        }
+        if (pending_ || !started_ || !alive_ || room_ < 0) return;
+        int target = directory_.pick(room_, id_, rng_);
+        if (target < 0) return;
+        pending_ = true;
+        pending_target_ = "Player" + to_string(target);
+        sent_at_ = Clock::now();
+        send("/challenge " + to_string(target) + " " + kMoves[rng_() % 3]);
+    }
+
+    void send(string line) {
+        line += '\n';
+        outbox_.push_back(std::move(line));
+        stats_.lines_sent.fetch_add(1, memory_order_relaxed);
+        if (outbox_.size() == 1) do_write();
+    }
+
+    void do_write() {
+        boost::asio::async_write(socket_, boost::asio::buffer(outbox_.front()),
+            [self = shared_from_this()](const boost::system::error_code& ec, size_t) {
+                if (ec) return;
+                self->outbox_.pop_front();
+                if (!self->outbox_.empty()) self->do_write();
+            });
+    }
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    tcp::socket socket_;
+    boost::asio::steady_timer timer_;
+    array<char, 16384> chunk_;
+    string inbox_;
+    deque<string> outbox_;
+    const Config& config_;
+    Stats& stats_;
+    RoomDirectory& directory_;
+    mt19937 rng_;
+    const bool slow_;
+
+    int id_ = -1;
+    string name_;
+    int room_ = -1;
+    bool started_ = false;
+    bool alive_ = true;
+    bool stopped_ = false;
+    bool pending_ = false;
+    string pending_target_;
+    Clock::time_point sent_at_;
+};
+
+// Resident set size of `pid` in KiB, or 0 if it can't be read.
+long read_rss_kib(int pid) {
+    if (pid <= 0) return 0;
+    ifstream status("/proc/" + to_string(pid) + "/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) return atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+// Asks the server for its own counters over a fresh connection.
+string fetch_server_stats(const tcp::endpoint& endpoint) {
+    try {
+        boost::asio::io_context io;
+        tcp::socket socket(io);
+        socket.connect(endpoint);
+        boost::asio::write(socket, boost::asio::buffer(string("/stats\n")));
+        boost::asio::streambuf buf;
+        istream in(&buf);
+        string line;
+        for (int i = 0; i < 64; ++i) {
+            boost::asio::read_until(socket, buf, '\n');
+            getline(in, line);
+            if (line.rfind("[STATS]", 0) == 0) return line;
+        }
+    } catch (const exception& e) {
+        return string("unavailable (") + e.what() + ")";
+    }
+    return "unavailable";
+}
+
+uint32_t percentile(const vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[min(idx, sorted.size() - 1)];
+}
+
+void raise_fd_limit() {
+    rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--scenario")) {
+            if (!apply_scenario(config, argv[++i])) {
+                cerr << "Unknown scenario: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg("--host")) {
+            config.host = argv[++i];
+        } else if (arg("--port")) {
+            config.port = static_cast<unsigned short>(atoi(argv[++i]));
+        } else if (arg("--bots")) {
+            config.bots = max(2, atoi(argv[++i]));
+        } else if (arg("--threads")) {
+            config.threads = max(1, atoi(argv[++i]));
+        } else if (arg("--duration")) {
+            config.duration_s = max(1, atoi(argv[++i]));
+        } else if (arg("--mode")) {
+            config.mode = argv[++i];
+        } else if (arg("--challenge-rate")) {
+            config.challenge_rate = atof(argv[++i]);
+        } else if (arg("--chat-rate")) {
+            config.chat_rate = atof(argv[++i]);
+        } else if (arg("--timeout-pct")) {
+            config.timeout_pct = atoi(argv[++i]);
+        } else if (arg("--slow-pct")) {
+            config.slow_pct = atoi(argv[++i]);
+        } else if (arg("--server-pid")) {
+            config.server_pid = atoi(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0]
+                 << " [--scenario mixed|deathmatch-flood|lms-storm|slow-reader] [--host H] [--port N]"
+                 << " [--bots N] [--threads N] [--duration S] [--mode deathmatch|lms]"
+                 << " [--challenge-rate R] [--chat-rate R] [--timeout-pct P] [--slow-pct P]"
+                 << " [--server-pid PID]" << endl;
+            return 1;
+        }
+    }
+    raise_fd_limit();
+
+    boost::asio::io_context io;
+    auto work = boost::asio::make_work_guard(io);
+    const tcp::endpoint endpoint(boost::asio::ip::make_address(config.host), config.port);
+    Stats stats;
+    RoomDirectory directory;
+
+    vector<thread> workers;
+    for (int i = 0; i < config.threads; ++i) workers.emplace_back([&io] { io.run(); });
+
+    vector<shared_ptr<Bot>> bots;
+    bots.reserve(config.bots);
+    const int num_slow = config.bots * config.slow_pct / 100;
+    for (int i = 0; i < config.bots; ++i) {
+        bots.push_back(make_shared<Bot>(io, config, stats, directory, 1000 + i, i < num_slow));
+        bots.back()->start(endpoint);
+    }
+
+    // Ramp-up: wait until everyone is in a room (or gave up) before measuring.
+    auto ramp_deadline = Clock::now() + chrono::seconds(15);
+    while (Clock::now() < ramp_deadline && stats.joined.load() + stats.failed.load() < config.bots) {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    printf("scenario %s: %d bots (%d connected, %d failed, %d slow), mode %s, %d s\n", config.scenario.c_str(),
+           config.bots, stats.connected.load(), stats.failed.load(), num_slow, config.mode.c_str(),
+           config.duration_s);
+
+    stats.reset();
+    stats.measuring = true;
+    const long rss_start = read_rss_kib(config.server_pid);
+    long rss_peak = rss_start;
+    auto start = Clock::now();
+    auto end = start + chrono::seconds(config.duration_s);
+    while (Clock::now() < end) {
+        this_thread::sleep_for(chrono::milliseconds(250));
+        rss_peak = max(rss_peak, read_rss_kib(config.server_pid));
+    }
+    stats.measuring = false;
+    const double secs = chrono::duration<double>(Clock::now() - start).count();
+    const long rss_end = read_rss_kib(config.server_pid);
+    const string server_stats = fetch_server_stats(endpoint);
+
+    vector<uint32_t> latencies;
+    {
+        lock_guard<mutex> lock(stats.latency_mutex);
+        latencies = stats.latencies_us;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    printf("matches: %llu completed, %llu timed out, %llu refused, %llu lost; %d bots disconnected by server\n",
+           static_cast<unsigned long long>(stats.matches.load()),
+           static_cast<unsigned long long>(stats.timeouts.load()),
+           static_cast<unsigned long long>(stats.refused.load()), static_cast<unsigned long long>(stats.lost.load()),
+           static_cast<int>(stats.disconnects.load()));
+    printf("match RTT (us): p50 %u  p99 %u  p999 %u  max %u  (n=%zu)\n", percentile(latencies, 0.50),
+           percentile(latencies, 0.99), percentile(latencies, 0.999), latencies.empty() ? 0 : latencies.back(),
+           latencies.size());
+    printf("messages/sec: %.0f sent, %.0f received\n", stats.lines_sent.load() / secs,
+           stats.lines_received.load() / secs);
+    if (config.server_pid > 0) {
+        printf("server RSS (MiB): start %.1f  peak %.1f  end %.1f\n", rss_start / 1024.0, rss_peak / 1024.0,
+               rss_end / 1024.0);
+    } else {
+        printf("server RSS: pass --server-pid to sample it\n");
+    }
+    printf("server: %s\n", server_stats.c_str());
+
+    for (auto& bot : bots) bot->stop();
+    work.reset();
+    io.stop();
+    for (auto& t : workers) t.join();
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Parser throughput: the old getline + rfind + istringstream path against
+// parse_command over string_views into the receive buffer.
+//
+//   parser_bench [lines]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <istream>
+#include <new>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../server/command_parser.hpp"
+
+using namespace std;
+
+static atomic<uint64_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// A read-only streambuf over an existing buffer, standing in for the
+// asio::streambuf the old handle_client read from.
+struct ViewBuf : streambuf {
+    explicit ViewBuf(const string& s) {
+        char* p = const_cast<char*>(s.data());
+        setg(p, p, p + s.size());
+    }
+};
+
+// What handle_client did per line before the parser existed. Returns a value
+// derived from the parse so the work can't be optimized away.
+static uint64_t legacy_parse(const string& msg) {
+    if (msg.rfind("/mode", 0) == 0) {
+        istringstream ss(msg);
+        string cmd, mode_choice;
+        ss >> cmd >> mode_choice;
+        return mode_choice.size();
+    } else if (msg.rfind("/challenge", 0) == 0) {
+        istringstream ss(msg);
+        string cmd;
+        int target_id = 0;
+        char move = 0;
+        ss >> cmd >> target_id >> move;
+        return static_cast<uint64_t>(target_id) + move;
+    } else if (msg.rfind("/move", 0) == 0) {
+        istringstream ss(msg);
+        string cmd;
+        char reply_move = 0;
+        ss >> cmd >> reply_move;
+        return reply_move;
+    }
+    return msg.size();
+}
+
+static uint64_t new_parse(string_view line) {
+    Command cmd = parse_command(line);
+    return static_cast<uint64_t>(cmd.type) + cmd.number + cmd.move + cmd.text.size() + cmd.word.size();
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_lines = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+
+    // A plausible mix: mostly match traffic, some chat and mode changes.
+    const vector<string> corpus = {
+        "/challenge 1234 R\n", "/move P\n", "/move S\n", "/challenge 42 s\n",
+        "/mode deathmatch\n", "/mode lms\n", "good game everyone, rematch?\n", "/move R\n",
+    };
+    string input;
+    for (size_t i = 0; i < num_lines; ++i) input += corpus[i % corpus.size()];
+
+    printf("%zu lines, %zu bytes\n", num_lines, input.size());
+    printf("%-18s %14s %14s\n", "parser", "lines/sec", "allocs/line");
+
+    {
+        ViewBuf buf(input);
+        istream stream(&buf);
+        uint64_t sink = 0;
+        auto before = allocation_count.load();
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < num_lines; ++i) {
+            string line;  // handle_client declared a fresh string per line
+            getline(stream, line);
+            sink += legacy_parse(line);
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double allocs = static_cast<double>(allocation_count.load() - before) / num_lines;
+        printf("%-18s %14.0f %14.2f   (sink %llu)\n", "getline+istream", num_lines / secs, allocs,
+               static_cast<unsigned long long>(sink));
+    }
+
+    {
+        string_view rest = input;
+        uint64_t sink = 0;
+        auto before = allocation_count.load();
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < num_lines; ++i) {
+            size_t nl = rest.find('\n');
+            sink += new_parse(rest.substr(0, nl));
+            rest.remove_prefix(nl + 1);
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double allocs = static_cast<double>(allocation_count.load() - before) / num_lines;
+        printf("%-18s %14.0f %14.2f   (sink %llu)\n", "parse_command", num_lines / secs, allocs,
+               static_cast<unsigned long long>(sink));
+    }
+    return 0;
+}
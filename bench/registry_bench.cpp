@@ -0,0 +1,106 @@
+// Contention benchmark: match resolutions/sec against the old single
+// map+mutex registry and the sharded PlayerRegistry, for 1..N threads.
+//
+//   registry_bench [players] [seconds_per_run] [max_threads]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../server/player_registry.hpp"
+
+using namespace std;
+
+// The body of a /move resolution once both players are in hand.
+static void resolve(Player& challenger, Player& challenged, uint32_t roll) {
+    challenger.num_games_played++;
+    challenged.num_games_played++;
+    if (roll % 3 == 0) challenger.games_won++;
+    else if (roll % 3 == 1) challenged.games_won++;
+    challenger.in_match = false;
+    challenged.in_match = false;
+    challenged.challenged_by = -1;
+}
+
+struct GlobalRegistry {
+    map<int, shared_ptr<Player>> players;
+    mutex players_mutex;
+
+    void resolve_match(int a, int b, uint32_t roll) {
+        lock_guard<mutex> lock(players_mutex);
+        auto ia = players.find(a);
+        auto ib = players.find(b);
+        if (ia != players.end() && ib != players.end()) resolve(*ia->second, *ib->second, roll);
+    }
+};
+
+struct ShardedRegistry {
+    PlayerRegistry registry{64};
+
+    void resolve_match(int a, int b, uint32_t roll) {
+        auto lock = registry.lock_pair(a, b);
+        auto pa = registry.find_locked(a);
+        auto pb = registry.find_locked(b);
+        if (pa && pb) resolve(*pa, *pb, roll);
+    }
+};
+
+template <typename Registry>
+double run(Registry& registry, int num_players, int num_threads, chrono::milliseconds duration) {
+    atomic<bool> stop{false};
+    atomic<uint64_t> total{0};
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            mt19937 rng(1234 + t);
+            uniform_int_distribution<int> pick(1, num_players);
+            uint64_t done = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                int a = pick(rng);
+                int b = pick(rng);
+                if (a == b) continue;
+                registry.resolve_match(a, b, rng());
+                ++done;
+            }
+            total.fetch_add(done);
+        });
+    }
+    this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& t : threads) t.join();
+    return total.load() / chrono::duration<double>(duration).count();
+}
+
+int main(int argc, char* argv[]) {
+    int num_players = argc > 1 ? atoi(argv[1]) : 10000;
+    int ms = argc > 2 ? static_cast<int>(atof(argv[2]) * 1000) : 1000;
+    int max_threads = argc > 3 ? atoi(argv[3]) : max(8u, thread::hardware_concurrency());
+
+    GlobalRegistry global;
+    ShardedRegistry sharded;
+    for (int id = 1; id <= num_players; ++id) {
+        auto p = make_shared<Player>();
+        p->id = id;
+        p->name = "Player" + to_string(id);
+        global.players.emplace(id, p);
+        auto q = make_shared<Player>(*p);
+        sharded.registry.insert(q);
+    }
+
+    printf("%d players, %d ms per run, %u hardware threads\n", num_players, ms, thread::hardware_concurrency());
+    printf("%8s %20s %20s\n", "threads", "global mutex (/s)", "sharded (/s)");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double g = run(global, num_players, threads, chrono::milliseconds(ms));
+        double s = run(sharded, num_players, threads, chrono::milliseconds(ms));
+        printf("%8d %20.0f %20.0f\n", threads, g, s);
+    }
+    return 0;
+}
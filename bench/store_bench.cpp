@@ -0,0 +1,110 @@
+// Restart cost of the player store: opening a directory that only has a log
+// (every record parsed and hashed) against one that was compacted into a
+// snapshot (mapped and used in place), plus lookups and save() cost. Works in
+// a fresh store_bench.XXXXXX directory it creates under `parent` and removes
+// only that.
+//
+//   store_bench [players] [parent]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "../server/player_store.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static double ms_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static bool open_timed(PlayerStore& store, const char* label) {
+    string error;
+    auto start = chrono::steady_clock::now();
+    if (!store.open(error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+    auto counts = store.counters();
+    printf("%-22s %10.1f ms   (%llu snapshot, %llu log)\n", label, ms_since(start),
+           static_cast<unsigned long long>(counts.snapshot_records),
+           static_cast<unsigned long long>(counts.log_records));
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int num_players = argc > 1 ? atoi(argv[1]) : 1000000;
+    string templ = ((argc > 2 ? fs::path(argv[2]) : fs::temp_directory_path()) / "store_bench.XXXXXX").string();
+    if (!mkdtemp(templ.data())) {
+        perror(templ.c_str());
+        return 1;
+    }
+    const fs::path dir = templ;
+    // Declared before the stores, so it runs after they have closed their files.
+    struct RemoveOnExit {
+        fs::path dir;
+        ~RemoveOnExit() {
+            error_code ec;
+            fs::remove_all(dir, ec);
+        }
+    } cleanup{dir};
+    fs::create_directory(dir / "log_only");
+    printf("%d players in %s\n", num_players, dir.c_str());
+
+    {
+        // No compaction until stop(), so the whole run stays in the log.
+        PlayerStore store((dir / "snapshot").string(), chrono::milliseconds(100), SIZE_MAX);
+        string error;
+        if (!store.open(error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        store.start();
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < num_players; ++i) {
+            store.save("player" + to_string(i), PlayerStore::Stats{i % 50, i % 20, 5, i % 3});
+        }
+        double queued = ms_since(start);
+        printf("%-22s %10.1f ms   (%.0f ns per save)\n", "save() calls", queued, queued * 1e6 / num_players);
+        while (store.counters().log_records < static_cast<uint64_t>(num_players)) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        printf("%-22s %10.1f ms   (%llu batches)\n", "written to log", ms_since(start),
+               static_cast<unsigned long long>(store.counters().batches_written));
+        // Keep the uncompacted log for the comparison below.
+        fs::copy_file(dir / "snapshot" / "players.log", dir / "log_only" / "players.log");
+        start = chrono::steady_clock::now();
+        store.stop();
+        printf("%-22s %10.1f ms\n", "compacted", ms_since(start));
+    }
+
+    {
+        PlayerStore store((dir / "log_only").string());
+        if (!open_timed(store, "open, log replay")) return 1;
+    }
+
+    PlayerStore store((dir / "snapshot").string());
+    if (!open_timed(store, "open, mapped snapshot")) return 1;
+
+    mt19937 rng(42);
+    const int lookups = 100000;
+    long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < lookups; ++i) {
+        PlayerStore::Stats stats;
+        if (store.load("player" + to_string(rng() % num_players), stats)) checksum += stats.games_played;
+    }
+    double elapsed = ms_since(start);
+    printf("%-22s %10.1f ms   (%.0f ns each, checksum %ld)\n", "100k cold lookups", elapsed,
+           elapsed * 1e6 / lookups, checksum);
+
+    return 0;
+}
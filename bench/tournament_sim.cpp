@@ -0,0 +1,244 @@
+// Plays millions of simulated games through the server's rules engine, for
+// tuning INITIAL_HP and the killing-spree rule. Each thread runs its games in
+// lockstep lanes: every step, each lane throws one match, all throws are
+// resolved by one resolve_batch call (SSE2), and the results are applied to a
+// PlayerTable with one row per seat.
+//
+// --check also resolves every throw with the scalar resolve() the server
+// uses on /move and fails if any outcome differs.
+//
+//   tournament_sim [--games N] [--mode lms|deathmatch] [--players N] [--hp N] [--spree N]
+//                  [--heal N] [--rounds N] [--threads N] [--seed N] [--check]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../server/rules.hpp"
+
+using namespace std;
+
+namespace {
+
+struct Options {
+    uint64_t games = 1000000;
+    bool lms = true;
+    int players = LMS_NUM_PLAYERS;
+    int rounds = 30;  // deathmatch games have no natural end
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    uint64_t seed = 1;
+    bool check = false;
+    RuleSet rules;
+};
+
+// Matches after which an LMS game is given up as endless.
+constexpr uint32_t kMaxMatches = 100000;
+constexpr size_t kLanes = 1024;
+constexpr int kMaxHpBucket = 16;
+
+struct Totals {
+    uint64_t games = 0;
+    uint64_t unfinished = 0;
+    uint64_t matches = 0;
+    uint64_t draws = 0;
+    uint64_t sprees = 0;
+    uint64_t winner_wins = 0;  // deathmatch: games won by the top seat
+    uint64_t checked = 0;
+    uint64_t mismatches = 0;
+    uint64_t winner_hp[kMaxHpBucket + 1] = {};
+
+    void add(const Totals& o) {
+        games += o.games, unfinished += o.unfinished, matches += o.matches, draws += o.draws;
+        sprees += o.sprees, winner_wins += o.winner_wins, checked += o.checked, mismatches += o.mismatches;
+        for (int i = 0; i <= kMaxHpBucket; ++i) winner_hp[i] += o.winner_hp[i];
+    }
+};
+
+// xorshift64*; one per thread.
+struct Rng {
+    uint64_t state;
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ull;
+    }
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>((next() >> 32) % n); }
+};
+
+void simulate(const Options& opt, uint64_t games, uint64_t seed, Totals& totals) {
+    const size_t seats = static_cast<size_t>(opt.players);
+    Rng rng{seed * 0x9E3779B97F4A7C15ull + 1};
+    PlayerTable table;
+    table.assign(kLanes * seats, opt.rules);
+    vector<uint8_t> first(kLanes, 0), second(kLanes, 0);
+    vector<Outcome> outcome(kLanes);
+    vector<uint32_t> seat_a(kLanes), seat_b(kLanes), matches(kLanes, 0);
+    vector<char> active(kLanes, 0);
+
+    auto reset_lane = [&](size_t lane) {
+        for (size_t s = 0; s < seats; ++s) table.set(lane * seats + s, Standing{opt.rules.initial_hp, 0, 0, 0});
+        matches[lane] = 0;
+    };
+    uint64_t started = 0;
+    size_t running = 0;
+    for (size_t lane = 0; lane < kLanes && started < games; ++lane, ++started, ++running) active[lane] = 1;
+
+    while (running > 0) {
+        // Every running lane challenges two distinct seats that are still alive.
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            if (!active[lane]) continue;
+            const size_t base = lane * seats;
+            uint32_t a, b;
+            do a = rng.below(opt.players); while (table.hp[base + a] <= 0 && opt.lms);
+            do b = rng.below(opt.players); while (b == a || (table.hp[base + b] <= 0 && opt.lms));
+            seat_a[lane] = a;
+            seat_b[lane] = b;
+            first[lane] = static_cast<uint8_t>(rng.below(3));
+            second[lane] = static_cast<uint8_t>(rng.below(3));
+        }
+
+        resolve_batch(first.data(), second.data(), outcome.data(), kLanes);
+
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            if (!active[lane]) continue;
+            if (opt.check) {
+                totals.checked++;
+                totals.mismatches += resolve(move_char(first[lane]), move_char(second[lane])) != outcome[lane];
+            }
+            const size_t base = lane * seats;
+            Standing sa = table.get(base + seat_a[lane]);
+            Standing sb = table.get(base + seat_b[lane]);
+            const ResultEffects effects = apply_result(opt.lms, opt.rules, outcome[lane], sa, sb);
+            table.set(base + seat_a[lane], sa);
+            table.set(base + seat_b[lane], sb);
+            totals.matches++;
+            totals.draws += outcome[lane] == Outcome::Draw;
+            totals.sprees += effects.spree;
+            matches[lane]++;
+
+            bool over = false;
+            if (opt.lms) {
+                if ((effects.first_died || effects.second_died) && lms_game_over(table.alive(base, base + seats))) {
+                    int hp = 0;
+                    for (size_t s = 0; s < seats; ++s) hp = max(hp, table.hp[base + s]);
+                    totals.winner_hp[min(hp, kMaxHpBucket)]++;
+                    over = true;
+                } else if (matches[lane] >= kMaxMatches) {
+                    totals.unfinished++;
+                    over = true;
+                }
+            } else if (matches[lane] >= static_cast<uint32_t>(opt.rounds)) {
+                totals.winner_wins += *max_element(table.games_won.begin() + base, table.games_won.begin() + base + seats);
+                over = true;
+            }
+            if (!over) continue;
+            totals.games++;
+            if (started < games) {
+                reset_lane(lane);
+                started++;
+            } else {
+                active[lane] = 0;
+                first[lane] = second[lane] = 0;
+                running--;
+            }
+        }
+    }
+}
+
+// The rule as written: rock beats scissors, paper beats rock, scissors beat paper.
+uint64_t check_table() {
+    const char* beats[] = {"RS", "PR", "SP"};
+    uint64_t mismatches = 0;
+    for (char a : {'R', 'P', 'S'}) {
+        for (char b : {'R', 'P', 'S'}) {
+            Outcome expected = Outcome::Draw;
+            for (const char* rule : beats) {
+                if (a == rule[0] && b == rule[1]) expected = Outcome::FirstWins;
+                if (b == rule[0] && a == rule[1]) expected = Outcome::SecondWins;
+            }
+            uint8_t ia = static_cast<uint8_t>(move_index(a)), ib = static_cast<uint8_t>(move_index(b));
+            Outcome batched;
+            resolve_batch(&ia, &ib, &batched, 1);
+            mismatches += (resolve(a, b) != expected) + (batched != expected);
+        }
+    }
+    return mismatches;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        auto value = [&] { return i + 1 < argc ? argv[++i] : "0"; };
+        if (strcmp(argv[i], "--games") == 0) opt.games = strtoull(value(), nullptr, 10);
+        else if (strcmp(argv[i], "--mode") == 0) opt.lms = strcmp(value(), "deathmatch") != 0;
+        else if (strcmp(argv[i], "--players") == 0) opt.players = max(2, atoi(value()));
+        else if (strcmp(argv[i], "--hp") == 0) opt.rules.initial_hp = max(1, atoi(value()));
+        else if (strcmp(argv[i], "--spree") == 0) opt.rules.spree_length = max(1, atoi(value()));
+        else if (strcmp(argv[i], "--heal") == 0) opt.rules.spree_heal = atoi(value());
+        else if (strcmp(argv[i], "--rounds") == 0) opt.rounds = max(1, atoi(value()));
+        else if (strcmp(argv[i], "--threads") == 0) opt.threads = max(1, atoi(value()));
+        else if (strcmp(argv[i], "--seed") == 0) opt.seed = strtoull(value(), nullptr, 10);
+        else if (strcmp(argv[i], "--check") == 0) opt.check = true;
+        else {
+            fprintf(stderr,
+                    "Usage: %s [--games N] [--mode lms|deathmatch] [--players N] [--hp N] [--spree N] [--heal N]"
+                    " [--rounds N] [--threads N] [--seed N] [--check]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if (opt.lms) {
+        printf("LMS, %d players, %d HP, +%d HP after %d wins in a row\n", opt.players, opt.rules.initial_hp,
+               opt.rules.spree_heal, opt.rules.spree_length);
+    } else {
+        printf("Deathmatch, %d players, %d matches per game\n", opt.players, opt.rounds);
+    }
+
+    vector<Totals> per_thread(opt.threads);
+    vector<thread> workers;
+    auto start = chrono::steady_clock::now();
+    for (unsigned t = 0; t < opt.threads; ++t) {
+        uint64_t share = opt.games / opt.threads + (t < opt.games % opt.threads);
+        workers.emplace_back([&, t, share] { simulate(opt, share, opt.seed + t, per_thread[t]); });
+    }
+    for (auto& w : workers) w.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    Totals total;
+    for (const auto& t : per_thread) total.add(t);
+    const double games = static_cast<double>(max<uint64_t>(total.games, 1));
+    printf("%llu games on %u threads in %.2f s (%.0f games/s, %.0f matches/s)\n",
+           static_cast<unsigned long long>(total.games), opt.threads, secs, total.games / secs, total.matches / secs);
+    printf("matches per game   %.2f\n", total.matches / games);
+    printf("draws              %.1f%%\n", 100.0 * total.draws / max<uint64_t>(total.matches, 1));
+    if (opt.lms) {
+        printf("spree heals/game   %.3f\n", total.sprees / games);
+        printf("winner's HP left  ");
+        for (int hp = 1; hp <= kMaxHpBucket; ++hp) {
+            if (total.winner_hp[hp]) printf(" %d%s: %.1f%%", hp, hp == kMaxHpBucket ? "+" : "", 100.0 * total.winner_hp[hp] / games);
+        }
+        printf("\n");
+        if (total.unfinished) printf("unfinished         %llu (gave up after %u matches)\n",
+                                     static_cast<unsigned long long>(total.unfinished), kMaxMatches);
+    } else {
+        printf("top seat's wins    %.1f%% of matches\n", 100.0 * total.winner_wins / (games * opt.rounds));
+    }
+
+    if (opt.check) {
+        uint64_t mismatches = total.mismatches + check_table();
+        printf("check              %llu throws, %llu mismatches\n", static_cast<unsigned long long>(total.checked + 9),
+               static_cast<unsigned long long>(mismatches));
+        if (mismatches) return 1;
+    }
+    return 0;
+}
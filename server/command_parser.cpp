@@ -0,0 +1,186 @@
+#include "command_parser.hpp"
+
+#include <array>
+#include <charconv>
+
+#include "player_store.hpp"
+
+using namespace std;
+
+namespace {
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Pops the next whitespace-separated token off the front of `in`.
+string_view next_token(string_view& in) {
+    size_t start = 0;
+    while (start < in.size() && is_space(in[start])) ++start;
+    size_t end = start;
+    while (end < in.size() && !is_space(in[end])) ++end;
+    string_view token = in.substr(start, end - start);
+    in.remove_prefix(end);
+    return token;
+}
+
+string_view trim(string_view in) {
+    while (!in.empty() && is_space(in.front())) in.remove_prefix(1);
+    while (!in.empty() && is_space(in.back())) in.remove_suffix(1);
+    return in;
+}
+
+bool parse_int(string_view token, int& out) {
+    if (token.empty()) return false;
+    auto [ptr, ec] = from_chars(token.data(), token.data() + token.size(), out);
+    return ec == errc() && ptr == token.data() + token.size();
+}
+
+Command invalid(string_view reason) {
+    Command cmd;
+    cmd.type = CommandType::Invalid;
+    cmd.text = reason;
+    return cmd;
+}
+
+Command parse_mode(string_view args) {
+    Command cmd;
+    cmd.word = next_token(args);
+    if (cmd.word != "deathmatch" && cmd.word != "lms") return invalid("Usage: /mode <deathmatch|lms>");
+    cmd.type = CommandType::Mode;
+    return cmd;
+}
+
+Command parse_queue(string_view args) {
+    Command cmd;
+    cmd.word = next_token(args);
+    if (cmd.word != "deathmatch" && cmd.word != "lms" && cmd.word != "leave") {
+        return invalid("Usage: /queue <deathmatch|lms> | /queue leave");
+    }
+    cmd.type = CommandType::Queue;
+    return cmd;
+}
+
+Command parse_login(string_view args) {
+    Command cmd;
+    cmd.text = next_token(args);
+    if (!PlayerStore::valid_name(cmd.text)) return invalid("Usage: /login <name> (1-31 letters, digits, _ or -)");
+    if (PlayerStore::guest_name(cmd.text)) return invalid("Player<number> names belong to guests; pick another.");
+    cmd.type = CommandType::Login;
+    return cmd;
+}
+
+Command parse_room(string_view args) {
+    static constexpr string_view kUsage =
+        "Usage: /room create <deathmatch|lms> [name] | /room join <id> | /room leave | /room list";
+    Command cmd;
+    string_view action = next_token(args);
+    if (action == "create") {
+        cmd.word = next_token(args);
+        if (cmd.word != "deathmatch" && cmd.word != "lms") return invalid(kUsage);
+        cmd.text = next_token(args);
+        cmd.type = CommandType::RoomCreate;
+    } else if (action == "join") {
+        if (!parse_int(next_token(args), cmd.number)) return invalid(kUsage);
+        cmd.type = CommandType::RoomJoin;
+    } else if (action == "leave") {
+        cmd.type = CommandType::RoomLeave;
+    } else if (action == "list") {
+        cmd.type = CommandType::RoomList;
+    } else {
+        return invalid(kUsage);
+    }
+    return cmd;
+}
+
+Command parse_challenge(string_view args) {
+    Command cmd;
+    if (!parse_int(next_token(args), cmd.number)) return invalid("Usage: /challenge <id> <R|P|S>");
+    cmd.move = normalize_move(next_token(args));
+    if (!cmd.move) return invalid("Invalid move. Use R, P or S.");
+    cmd.type = CommandType::Challenge;
+    return cmd;
+}
+
+Command parse_move(string_view args) {
+    Command cmd;
+    cmd.move = normalize_move(next_token(args));
+    if (!cmd.move) return invalid("Invalid move. Use R, P or S.");
+    cmd.type = CommandType::Move;
+    return cmd;
+}
+
+Command parse_status(string_view) {
+    Command cmd;
+    cmd.type = CommandType::Status;
+    return cmd;
+}
+
+Command parse_stats(string_view) {
+    Command cmd;
+    cmd.type = CommandType::Stats;
+    return cmd;
+}
+
+// Optional numeric argument; `number` stays -1 when it is absent.
+Command parse_optional_number(string_view args, CommandType type, string_view usage) {
+    Command cmd;
+    string_view token = next_token(args);
+    if (!token.empty() && (!parse_int(token, cmd.number) || cmd.number < 0)) return invalid(usage);
+    cmd.type = type;
+    return cmd;
+}
+
+Command parse_leaderboard(string_view args) {
+    return parse_optional_number(args, CommandType::Leaderboard, "Usage: /leaderboard [k]");
+}
+
+Command parse_rank(string_view args) {
+    return parse_optional_number(args, CommandType::Rank, "Usage: /rank [id]");
+}
+
+struct Entry {
+    string_view verb;
+    Command (*parse)(string_view args);
+};
+
+constexpr array<Entry, 10> kCommands = {{
+    {"/challenge", parse_challenge},
+    {"/leaderboard", parse_leaderboard},
+    {"/login", parse_login},
+    {"/move", parse_move},
+    {"/mode", parse_mode},
+    {"/queue", parse_queue},
+    {"/rank", parse_rank},
+    {"/room", parse_room},
+    {"/status", parse_status},
+    {"/stats", parse_stats},
+}};
+
+}  // namespace
+
+char normalize_move(string_view token) {
+    if (token.size() != 1) return '\0';
+    switch (token[0]) {
+        case 'R': case 'r': return 'R';
+        case 'P': case 'p': return 'P';
+        case 'S': case 's': return 'S';
+        default: return '\0';
+    }
+}
+
+Command parse_command(string_view line) {
+    line = trim(line);
+    if (line.empty() || line.front() != '/') {
+        Command chat;
+        chat.text = line;
+        return chat;
+    }
+    string_view rest = line;
+    string_view verb = next_token(rest);
+    for (const auto& entry : kCommands) {
+        if (entry.verb == verb) return entry.parse(rest);
+    }
+    // Unknown slash commands are chat, as they always were.
+    Command chat;
+    chat.text = line;
+    return chat;
+}
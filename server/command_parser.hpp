@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+enum class CommandType : std::uint8_t {
+    Chat,        // anything that isn't a known command
+    Mode,        // /mode <deathmatch|lms>
+    RoomCreate,  // /room create <mode> [name]
+    RoomJoin,    // /room join <id>
+    RoomLeave,   // /room leave
+    RoomList,    // /room list
+    Challenge,   // /challenge <id> <R|P|S>
+    Move,        // /move <R|P|S>
+    Status,      // /status
+    Stats,       // /stats
+    Leaderboard, // /leaderboard [k]
+    Rank,        // /rank [id]
+    Queue,       // /queue <deathmatch|lms|leave>
+    Login,       // /login <name>
+    Invalid,     // a known command with bad arguments; `text` says why
+};
+
+// A parsed line. The views point into the line that was parsed, so a Command
+// must not outlive the receive buffer it came from.
+struct Command {
+    CommandType type = CommandType::Chat;
+    int number = -1;        // /challenge target, /room join id, /leaderboard k, /rank id
+    char move = '\0';       // normalized to 'R', 'P' or 'S'
+    std::string_view word;  // /mode, /room create, /queue: the mode name (or "leave")
+    std::string_view text;  // chat text, /room create name, /login name, or the Invalid reason
+};
+
+// Tokenizes in place: no allocation, no streams. IDs go through from_chars and
+// moves are validated here, so handlers only ever see well-formed commands.
+Command parse_command(std::string_view line);
+
+// 'R', 'P' or 'S' for r/p/s in either case, '\0' otherwise.
+char normalize_move(std::string_view token);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash map from non-negative int keys to V. Entries live in one
+// contiguous array (linear probing, backward-shift erase), so lookups touch a
+// cache line or two instead of chasing tree or bucket nodes.
+template <typename V>
+class FlatIntMap {
+public:
+    FlatIntMap() { slots_.resize(kMinCapacity); }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    V* find(int key) {
+        for (std::size_t i = home(key);; i = next(i)) {
+            if (slots_[i].key == key) return &slots_[i].value;
+            if (slots_[i].key == kEmpty) return nullptr;
+        }
+    }
+    const V* find(int key) const { return const_cast<FlatIntMap*>(this)->find(key); }
+
+    // Returns false (and leaves the map unchanged) if key is already present.
+    bool insert(int key, V value) {
+        if ((size_ + 1) * 10 > slots_.size() * 7) grow();
+        for (std::size_t i = home(key);; i = next(i)) {
+            if (slots_[i].key == key) return false;
+            if (slots_[i].key == kEmpty) {
+                slots_[i].key = key;
+                slots_[i].value = std::move(value);
+                ++size_;
+                return true;
+            }
+        }
+    }
+
+    bool erase(int key) {
+        std::size_t i = home(key);
+        for (;; i = next(i)) {
+            if (slots_[i].key == key) break;
+            if (slots_[i].key == kEmpty) return false;
+        }
+        // Shift later members of the probe run back so no tombstone is needed.
+        for (std::size_t j = next(i);; j = next(j)) {
+            if (slots_[j].key == kEmpty) break;
+            std::size_t h = home(slots_[j].key);
+            bool movable = (i <= j) ? (h <= i || h > j) : (h <= i && h > j);
+            if (movable) {
+                slots_[i] = std::move(slots_[j]);
+                i = j;
+            }
+        }
+        slots_[i].key = kEmpty;
+        slots_[i].value = V();
+        --size_;
+        return true;
+    }
+
+    template <typename F>
+    void for_each(F&& f) const {
+        for (const auto& slot : slots_) {
+            if (slot.key != kEmpty) f(slot.key, slot.value);
+        }
+    }
+
+private:
+    static constexpr int kEmpty = std::numeric_limits<int>::min();
+    static constexpr std::size_t kMinCapacity = 16;
+
+    struct Slot {
+        int key = kEmpty;
+        V value{};
+    };
+
+    std::size_t home(int key) const {
+        // Fibonacci hashing spreads sequential ids across the table.
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32)
+               & (slots_.size() - 1);
+    }
+    std::size_t next(std::size_t i) const { return (i + 1) & (slots_.size() - 1); }
+
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots_);
+        slots_.resize(old.size() * 2);
+        size_ = 0;
+        for (auto& slot : old) {
+            if (slot.key != kEmpty) insert(slot.key, std::move(slot.value));
+        }
+    }
+
+    std::vector<Slot> slots_;
+    std::size_t size_ = 0;
+};
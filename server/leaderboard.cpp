@@ -0,0 +1,76 @@
+#include "leaderboard.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+bool Leaderboard::in_cached_prefix(const Key& key) const {
+    // A short board is cached whole, so any change touches it.
+    if (tree_.size() <= kMaxTop || cache_.empty()) return true;
+    return !Better()(cache_boundary_, key);
+}
+
+void Leaderboard::update(int id, const string& name, int games_played, int games_won) {
+    lock_guard<mutex> lock(mutex_);
+    Key key{games_won, games_played, id};
+    auto [it, inserted] = entries_.try_emplace(id, Entry{key, name});
+    bool touches_cache = !cache_valid_;
+    if (!inserted) {
+        // Only a change inside the cached prefix (leaving it, entering it or
+        // moving within it) needs a rebuild; the long tail doesn't.
+        if (!touches_cache) touches_cache = in_cached_prefix(it->second.key);
+        tree_.erase(it->second.key);
+        it->second = Entry{key, name};
+    }
+    tree_.insert(key);
+    if (!touches_cache) touches_cache = in_cached_prefix(key);
+    if (touches_cache) cache_valid_ = false;
+}
+
+void Leaderboard::remove(int id) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = entries_.find(id);
+    if (it == entries_.end()) return;
+    if (cache_valid_ && in_cached_prefix(it->second.key)) cache_valid_ = false;
+    tree_.erase(it->second.key);
+    entries_.erase(it);
+}
+
+vector<Leaderboard::Row> Leaderboard::top(size_t k) {
+    lock_guard<mutex> lock(mutex_);
+    if (!cache_valid_) {
+        cache_.clear();
+        int rank = 1;
+        for (auto it = tree_.begin(); it != tree_.end() && cache_.size() < kMaxTop; ++it, ++rank) {
+            const auto& entry = entries_.at(it->id);
+            cache_.push_back(Row{rank, it->id, entry.name, it->games_played, it->games_won});
+        }
+        if (!cache_.empty()) {
+            const Row& last = cache_.back();
+            cache_boundary_ = Key{last.games_won, last.games_played, last.id};
+        }
+        cache_valid_ = true;
+        cache_rebuilds_++;
+    }
+    k = min({k, kMaxTop, cache_.size()});
+    return vector<Row>(cache_.begin(), cache_.begin() + k);
+}
+
+int Leaderboard::rank(int id, Row* row) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = entries_.find(id);
+    if (it == entries_.end()) return 0;
+    int rank = static_cast<int>(tree_.order_of_key(it->second.key)) + 1;
+    if (row) *row = Row{rank, id, it->second.name, it->second.key.games_played, it->second.key.games_won};
+    return rank;
+}
+
+uint64_t Leaderboard::cache_rebuilds() {
+    lock_guard<mutex> lock(mutex_);
+    return cache_rebuilds_;
+}
+
+size_t Leaderboard::size() {
+    lock_guard<mutex> lock(mutex_);
+    return tree_.size();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Players ordered by (win ratio, games won, id), kept in an order-statistics
+// tree so rank and top-K lookups are O(log N) however many players there are.
+// Updated incrementally whenever a result is recorded; thread-safe, and its
+// lock may be taken while holding registry shard locks.
+class Leaderboard {
+public:
+    // Largest k /leaderboard answers; also the size of the cached prefix.
+    static constexpr std::size_t kMaxTop = 100;
+
+    struct Row {
+        int rank;
+        int id;
+        std::string name;
+        int games_played;
+        int games_won;
+        double win_ratio() const { return games_played ? static_cast<double>(games_won) / games_played : 0.0; }
+    };
+
+    // Inserts or repositions a player.
+    void update(int id, const std::string& name, int games_played, int games_won);
+    void remove(int id);
+
+    // The best min(k, kMaxTop) players. Served from a cache that is only
+    // rebuilt after an update that changed the cached prefix.
+    std::vector<Row> top(std::size_t k);
+    // 1-based rank, or 0 if the player isn't ranked.
+    int rank(int id, Row* row = nullptr);
+    std::size_t size();
+
+    std::uint64_t cache_rebuilds();
+
+private:
+    struct Key {
+        int games_won;
+        int games_played;
+        int id;
+    };
+    // "Better" first: higher ratio (compared exactly, as cross products),
+    // then more wins, then the lower id.
+    struct Better {
+        bool operator()(const Key& a, const Key& b) const {
+            auto lhs = static_cast<std::int64_t>(a.games_won) * (b.games_played ? b.games_played : 1);
+            auto rhs = static_cast<std::int64_t>(b.games_won) * (a.games_played ? a.games_played : 1);
+            if (lhs != rhs) return lhs > rhs;
+            if (a.games_won != b.games_won) return a.games_won > b.games_won;
+            return a.id < b.id;
+        }
+    };
+    using Tree = __gnu_pbds::tree<Key, __gnu_pbds::null_type, Better, __gnu_pbds::rb_tree_tag,
+                                  __gnu_pbds::tree_order_statistics_node_update>;
+
+    struct Entry {
+        Key key;
+        std::string name;
+    };
+
+    // Caller holds mutex_ and the cache is valid. True if `key` sits inside
+    // the cached prefix.
+    bool in_cached_prefix(const Key& key) const;
+
+    std::mutex mutex_;
+    Tree tree_;
+    std::unordered_map<int, Entry> entries_;
+
+    std::vector<Row> cache_;
+    Key cache_boundary_{};  // the last cached key
+    bool cache_valid_ = false;
+    std::uint64_t cache_rebuilds_ = 0;
+};
@@ -1,416 +1,1211 @@
 #include <iostream>
 #include <boost/asio.hpp>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 #include <mutex>
 #include <memory>
-#include <map>
+#include <unordered_set>
 #include <sstream>
-#include <algorithm> 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <deque>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <sys/resource.h>
+
+#include "command_parser.hpp"
+#include "leaderboard.hpp"
+#include "match.hpp"
+#include "metrics.hpp"
+#include "metrics_endpoint.hpp"
+#include "player_registry.hpp"
+#include "player_store.hpp"
+#include "room.hpp"
+#include "rules.hpp"
+#include "session.hpp"
+#include "timer_wheel.hpp"
+#include "websocket_session.hpp"
 
 using boost::asio::ip::tcp;
 using namespace std;
 
-enum class GameMode { NONE, DEATHMATCH, LAST_MAN_STANDING };
+const auto CHALLENGE_TIMEOUT = chrono::seconds(10);
+// Chat a room holds back while overloaded; lines past this are dropped.
+const size_t MAX_HELD_CHAT_BYTES = 16 * 1024;
+
+std::atomic<int> global_challenge_id{0};
+// How the /queue matchmaker orders waiting players before pairing them.
+MatchPolicy match_policy = MatchPolicy::Fifo;
 
-const int LMS_NUM_PLAYERS = 3; 
-const int INITIAL_HP = 5;
+PlayerRegistry registry;
 
-struct Player {
-    int id;
-    string name;
-    shared_ptr<tcp::socket> socket;
-    int num_games_played = 0;
-    int games_won = 0;
-    bool in_match = false;
-    int challenged_by = -1;
-    char pending_choice = '\0';
-    bool challenge_responded = false;
-    int hp = INITIAL_HP;
-    int current_winstreak = 0;
-    int challenge_id = 0;
-    GameMode mode = GameMode::NONE;
-
-    float win_ratio() const {
-        if (num_games_played == 0) return 0.0f;
-        return num_games_played > 0 ? static_cast<double>(games_won) / num_games_played : 0.0;
+// Created in main(). Game state (mode, started, members) lives in each Room and
+// is only touched on that room's strand.
+unique_ptr<RoomManager> rooms;
+
+// Owns every pending challenge deadline; created in main().
+unique_ptr<TimerWheel> challenge_timers;
+
+// Connected players by win ratio; see /leaderboard and /rank.
+Leaderboard leaderboard;
+
+// Stats of /login names across restarts; null unless --data-dir is given.
+unique_ptr<PlayerStore> player_store;
+
+// Names logged in right now, so a name is only ever played from one session.
+mutex online_names_mutex;
+unordered_set<string> online_names;
+
+// Caller holds p's shard lock. Skips players that already disconnected, so a
+// match resolving late can't put them back on the board; named players are
+// saved either way. Saving only queues the record for the store's writer.
+void record_result(const Player& p) {
+    if (p.persistent && player_store) {
+        player_store->save(p.name, PlayerStore::Stats{p.num_games_played, p.games_won, p.hp, p.current_winstreak});
     }
-};
+    if (registry.find_locked(p.id)) leaderboard.update(p.id, p.name, p.num_games_played, p.games_won);
+}
 
-std::atomic<int> global_challenge_id{0};
+void send_to(const shared_ptr<Player>& p, string message) {
+    if (p->session) p->session->deliver(std::move(message));
+}
 
-map<int, shared_ptr<Player>> players;
-mutex players_mutex;
-GameMode selected_mode = GameMode::NONE;
-
-int lms_players_connected = 0;
-bool lms_game_started = false;
-int deathmatch_players_connected = 0;
-bool deathmatch_game_started = false;
-
-void broadcast(const string& message, shared_ptr<tcp::socket> sender) {
-    lock_guard<mutex> lock(players_mutex);
-    for (auto& [id, p] : players) {
-        if (p->socket && p->socket != sender) {
-            try {
-                boost::asio::write(*p->socket, boost::asio::buffer(message));
-            } catch (...) {
-                // Silently fail if client is disconnected
-            }
+shared_ptr<Room> current_room(const shared_ptr<Player>& player) {
+    auto lock = registry.lock(player->id);
+    return player->room;
+}
+
+// Appends "Name | Games: N | Ratio: 0.00 | HP: N\n" without a stream per row.
+void append_status_row(string& out, const Player& p) {
+    char ratio[16];
+    snprintf(ratio, sizeof(ratio), "%.2f", p.win_ratio());
+    out += p.name;
+    out += " | Games: ";
+    out += to_string(p.num_games_played);
+    out += " | Ratio: ";
+    out += ratio;
+    out += " | HP: ";
+    out += to_string(p.hp);
+    out += '\n';
+}
+
+// Player-status updates are coalesced per room: anything that changes a row
+// marks the player dirty, and every status tick the changed rows go out to the
+// room as one [PLAYER_STATUS_DELTA <version>] message. Full
+// [PLAYER_STATUS <version>] snapshots are only sent on entering a room, on
+// /status, and to sessions that had a status message dropped by their
+// outbound queue. All of these run on the room's strand.
+void mark_status_dirty(Room& room, int player_id) {
+    room.dirty_players.insert(player_id);
+    room.status_pending.store(true, memory_order_relaxed);
+}
+
+void mark_status_departed(Room& room, const string& name) {
+    room.departed_players.push_back(name);
+    room.status_pending.store(true, memory_order_relaxed);
+}
+
+string build_full_status(Room& room) {
+    string list;
+    list.reserve(32 + room.member_count() * 48);
+    list = "[PLAYER_STATUS " + to_string(room.status_version) + "]\n";
+    room.members().for_each([&](int id, const shared_ptr<Player>& p) {
+        auto lock = registry.lock(id);
+        append_status_row(list, *p);
+    });
+    list += "[PLAYER_STATUS_END]\n";
+    return list;
+}
+
+void send_full_status(Room& room, const shared_ptr<Player>& player) {
+    if (player->session) player->session->deliver(build_full_status(room), MessageKind::Status);
+}
+
+void flush_room_status(Room& room) {
+    room.status_pending.store(false, memory_order_relaxed);
+    if (room.dirty_players.empty() && room.departed_players.empty()) return;
+    ScopedTimer timer(Histogram::StatusFlush);
+    unordered_set<int> dirty;
+    vector<string> departed;
+    dirty.swap(room.dirty_players);
+    departed.swap(room.departed_players);
+    uint64_t version = ++room.status_version;
+
+    string delta = "[PLAYER_STATUS_DELTA " + to_string(version) + "]\n";
+    for (int id : dirty) {
+        auto found = room.members().find(id);
+        if (!found) continue;
+        auto lock = registry.lock(id);
+        append_status_row(delta, **found);
+    }
+    for (const auto& name : departed) delta += name + " | left\n";
+    delta += "[PLAYER_STATUS_END]\n";
+
+    auto delta_buffer = MessageBuffer::make(delta);
+    MessageBuffer full_buffer;
+    uint64_t recipients = 0, bytes = 0;
+    for (auto& session : room.member_sessions()) {
+        if (session->take_status_resync()) {
+            if (!full_buffer) full_buffer = MessageBuffer::make(build_full_status(room));
+            session->deliver(full_buffer, MessageKind::Status);
+            bytes += full_buffer.size();
+        } else {
+            session->deliver(delta_buffer, MessageKind::Status);
+            bytes += delta_buffer.size();
         }
+        recipients++;
     }
+    Metrics::add(Counter::BroadcastMessages);
+    Metrics::add(Counter::BroadcastDeliveries, recipients);
+    Metrics::add(Counter::BroadcastBytes, bytes);
 }
-void broadcast_to_all(const string& message) {
-    lock_guard<mutex> lock(players_mutex);
-    for (auto& [id, p] : players) {
-        try {
-            boost::asio::write(*p->socket, boost::asio::buffer(message));
-        } catch (...) {
-            // Ignore disconnects
-        }
+
+// Strand of `room`. Chat that arrives while the server is overloaded, or
+// behind lines already held, waits for the next tick instead of going out on
+// its own.
+void hold_chat(Room& room, int sender, string line) {
+    if (room.held_chat_bytes + line.size() > MAX_HELD_CHAT_BYTES) {
+        Metrics::add(Counter::ChatShed, room.member_count());
+        return;
     }
+    room.held_chat_bytes += line.size();
+    room.held_chat.push_back(Room::HeldChat{sender, std::move(line)});
+    room.chat_pending.store(true, memory_order_relaxed);
+    Metrics::add(Counter::ChatHeld);
 }
 
-void broadcast_player_status() {
-    string list ="";
-    {
-    lock_guard<mutex> lock(players_mutex);
-    list = "[PLAYER_STATUS]\n";
-    for (auto& [id, p] : players) {
-        try{
-            if (!p) {
-                cerr << "[ERROR] Null player pointer for ID: " << id << endl;
-                continue;
+// Strand of `room`. Once the overload has passed, sends everything held as one
+// message per member: one shared buffer for most of them, and a copy without
+// their own lines for each player who wrote some.
+void flush_room_chat(Room& room) {
+    if (room.held_chat.empty()) {
+        room.chat_pending.store(false, memory_order_relaxed);
+        return;
+    }
+    if (Session::overloaded()) return;  // still pending; try again next tick
+    room.chat_pending.store(false, memory_order_relaxed);
+    vector<Room::HeldChat> held;
+    held.swap(room.held_chat);
+    room.held_chat_bytes = 0;
+
+    string all;
+    vector<int> senders;
+    for (const auto& chat : held) {
+        all += chat.line;
+        senders.push_back(chat.sender);
+    }
+    sort(senders.begin(), senders.end());
+    senders.erase(unique(senders.begin(), senders.end()), senders.end());
+
+    auto all_buffer = MessageBuffer::make(all);
+    uint64_t recipients = 0, bytes = 0;
+    room.members().for_each([&](int id, const shared_ptr<Player>& p) {
+        if (!p->session) return;
+        if (!binary_search(senders.begin(), senders.end(), id)) {
+            p->session->deliver(all_buffer, MessageKind::Chat);
+            bytes += all_buffer.size();
+        } else {
+            string others;
+            for (const auto& chat : held) {
+                if (chat.sender != id) others += chat.line;
             }
-            ostringstream oss;
-            oss.precision(2);
-            oss << fixed << p->win_ratio();
-            list += p->name + " | Games: " + to_string(p->num_games_played)  +
-                " | Ratio: " + oss.str() + " | HP: " + to_string(p->hp) + "\n";
-        } catch (const std::exception& e) {
-            cerr << "Exception while broadcasting player status: " << e.what() << endl;
+            if (others.empty()) return;
+            bytes += others.size();
+            p->session->deliver(MessageBuffer::make(others), MessageKind::Chat);
         }
-        
-    }
- 
-    list += "[PLAYER_STATUS_END]\n";
+        recipients++;
+    });
+    Metrics::add(Counter::BroadcastMessages);
+    Metrics::add(Counter::BroadcastDeliveries, recipients);
+    Metrics::add(Counter::BroadcastBytes, bytes);
+}
+
+void flush_player_status() {
+    for (auto& room : rooms->list()) {
+        if (!room->status_pending.load(memory_order_relaxed) && !room->chat_pending.load(memory_order_relaxed)) {
+            continue;
+        }
+        boost::asio::post(room->strand(), [room] {
+            flush_room_status(*room);
+            flush_room_chat(*room);
+        });
     }
-    broadcast_to_all(list);
 }
-void check_lms_game_end() {
+
+void schedule_status_flush(boost::asio::steady_timer& timer, chrono::milliseconds tick) {
+    timer.expires_after(tick);
+    timer.async_wait([&timer, tick](const boost::system::error_code& ec) {
+        if (ec) return;
+        flush_player_status();
+        schedule_status_flush(timer, tick);
+    });
+}
+
+RuleSet rules_of(const Room& room) {
+    RuleSet rules;
+    rules.initial_hp = room.rules().initial_hp;
+    return rules;
+}
+
+// Caller holds both players' shard locks. Runs the result through the rules
+// engine (the same code tournament_sim uses) and writes the standings back.
+ResultEffects apply_result(const Room& room, bool lms, Outcome outcome, Player& first, Player& second) {
+    return apply_result(lms, rules_of(room), outcome, first, second);
+}
+
+bool lms_active(const Room& room) {
+    return room.mode() == GameMode::LAST_MAN_STANDING && room.started();
+}
+
+void check_lms_game_end(Room& room) {
     int alive = 0;
     string last_alive;
-    for (auto& [id, p] : players) {
-        if (p->mode == GameMode::LAST_MAN_STANDING && p->hp > 0) {
+    room.members().for_each([&](int id, const shared_ptr<Player>& p) {
+        auto lock = registry.lock(id);
+        if (p->hp > 0) {
             alive++;
             last_alive = p->name;
         }
-    }
-    if (alive == 1 && lms_game_started) {
-        string msg = "Game Over! Winner: " + last_alive + "\n";
-        broadcast(msg, nullptr);
-        lms_game_started = false;
-
-        broadcast_player_status();
-    }
+    });
+    if (!lms_game_over(alive) || !lms_active(room)) return;
+    room.set_started(false);
+    string msg = "Game Over! Winner: " + last_alive + "\n";
+    room.broadcast(msg);
 }
-void challenge_timeout(shared_ptr<Player> challenger, shared_ptr<Player> challenged, int challenge_id) {
-    this_thread::sleep_for(chrono::seconds(10));
-    // If the challenged player hasn't responded, challenger wins by timeout
+
+// Fired (via the room strand) once CHALLENGE_TIMEOUT passes without the match
+// resolving. Whoever locked in a move wins by timeout; a queued match in which
+// neither side moved is called off.
+void challenge_timeout(const shared_ptr<Room>& room, shared_ptr<Player> challenger,
+                       shared_ptr<Player> challenged, int challenge_id) {
     bool timeoutOccurred = false;
+    bool no_contest = false;
+    const bool lms = lms_active(*room);
+    string timeout_msg, killstreak_msg, dead_msg;
     // Lock only the critical section where data is being modified
     {
-        lock_guard<mutex> lock(players_mutex);
-        if (challenger->in_match && challenged->in_match 
-            && challenger->challenge_id == challenge_id 
-            && challenged->challenge_id == challenge_id) {
+        auto lock = registry.lock_pair(challenger->id, challenged->id);
+        // /move cancels the timer, so this only rejects the rare expiry that was
+        // already being fired when the match resolved. A player who has
+        // disconnected is out of the registry; call_off_match releases the
+        // other side.
+        const bool live = challenger->in_match && challenged->in_match
+                          && challenger->challenge_id == challenge_id
+                          && challenged->challenge_id == challenge_id
+                          && registry.find_locked(challenger->id) == challenger
+                          && registry.find_locked(challenged->id) == challenged;
+        // In a queued match either side may be the one that moved.
+        if (live && challenger->pending_choice == '\0' && challenged->pending_choice != '\0') {
+            swap(challenger, challenged);
+        }
+        if (live && challenger->pending_choice == '\0') {
+            no_contest = true;
+            end_match(*challenger);
+            end_match(*challenged);
+            timeout_msg = "Match cancelled: neither " + challenger->name + " nor " + challenged->name
+                          + " moved in time.\n";
+        } else if (live) {
             timeoutOccurred = true;
-            challenger->num_games_played++;
-            challenged->num_games_played++;
-            if (selected_mode == GameMode::LAST_MAN_STANDING && lms_game_started) {
-                challenger->games_won++;
-                challenger->current_winstreak++;
-                challenged->hp--;
-                challenged->in_match = false;
-                if (challenged->hp <= 0) {
-                    challenged->in_match = true;
-                }
+            const ResultEffects effects = settle_timeout(lms, rules_of(*room), *challenger, *challenged);
+            if (lms) {
+                timeout_msg = challenged->name + " lost 1 HP by timeout! Remaining HP: " + to_string(challenged->hp) + "\n";
+                if (effects.spree) killstreak_msg = "🔥 Killing Spree! " + challenger->name + " gains +1 HP! 🔥\n";
+                if (effects.second_died) dead_msg = challenged->name + " has died.\n";
             } else {
-                challenger->games_won++;
-                challenged->in_match = false;
-                challenged->challenged_by = -1;
-                challenged->challenge_responded = false;
-            }
-            // Reset match state for challenger
-            challenger->in_match = false;
-            challenger->pending_choice = '\0';
-        }
-    }
-    if (timeoutOccurred) {
-        string timeout_msg;
-        if (selected_mode == GameMode::LAST_MAN_STANDING && lms_game_started) {
-            timeout_msg = challenged->name + " lost 1 HP by timeout! Remaining HP: " + to_string(challenged->hp) + "\n";
-            if (challenger->current_winstreak == 3 && challenger->hp > 0) {
-                challenger->hp++;
-                broadcast("🔥 Killing Spree! " + challenger->name + " gains +1 HP! 🔥\n", nullptr);
-                challenger->current_winstreak = 0;
-            }
-            if (challenged->hp <= 0) {
-                string dead_msg = challenged->name + " has died.\n";
-                broadcast(dead_msg, nullptr);
+                timeout_msg = "Match Result: " + challenger->name + " wins by timeout (no response from " +
+                              challenged->name + ")\n";
             }
-            check_lms_game_end();
-        } else {
-            timeout_msg = "Match Result: " + challenger->name + " wins by timeout (no response from " +
-                          challenged->name + ")\n";
+            record_result(*challenger);
+            record_result(*challenged);
         }
+    }
+    if (no_contest) {
+        room->broadcast(timeout_msg);
+    } else if (timeoutOccurred) {
+        Metrics::add(Counter::ChallengeTimeouts);
+        mark_status_dirty(*room, challenger->id);
+        mark_status_dirty(*room, challenged->id);
+        if (!killstreak_msg.empty()) room->broadcast(killstreak_msg);
+        if (!dead_msg.empty()) room->broadcast(dead_msg);
+        if (lms) check_lms_game_end(*room);
+        room->broadcast(timeout_msg);
+    }
+}
 
-        broadcast(timeout_msg, nullptr);
-        broadcast_player_status(); 
+// Strand of `room`. Puts the player in the room's matchmaking queue.
+void enqueue_player(const shared_ptr<Room>& room, const shared_ptr<Player>& player) {
+    {
+        auto lock = registry.lock(player->id);
+        if (player->hp <= 0) {
+            send_to(player, "You can't queue while dead.\n");
+            return;
+        }
+    }
+    if (!room->match_queue.enqueue(player->id)) {
+        send_to(player, "You are already queued.\n");
+        return;
     }
+    send_to(player, string("Queued for ") + mode_name(room->mode()) + ". Waiting for an opponent...\n");
 }
 
-void handle_client(shared_ptr<tcp::socket> socket, int player_id) {
-    boost::asio::streambuf buffer;
-    istream input(&buffer);
-   
+// Strand of `room`. One matchmaking pass: pairs everyone queued here in the
+// order the policy picks, sets every match up in one sweep, then schedules
+// all their timeouts as one batch.
+void form_matches(const shared_ptr<Room>& room) {
+    auto waiting = room->match_queue.drain();
+    if (waiting.empty()) return;
+    if (room->mode() == GameMode::LAST_MAN_STANDING && !room->started()) {
+        for (const auto& w : waiting) room->match_queue.requeue(w);
+        return;
+    }
 
-    // Register the player
-    auto player = make_shared<Player>();
-    player->id = player_id;
-    player->name = "Player" + to_string(player_id);
-    player->socket = socket;
+    // Drop anyone who left or died; rate the rest.
+    vector<MatchQueue::Waiting> ready;
+    ready.reserve(waiting.size());
+    for (auto& w : waiting) {
+        const auto* member = room->members().find(w.player_id);
+        if (!member) continue;
+        const Player& p = **member;
+        auto lock = registry.lock(p.id);
+        if (p.hp <= 0 || p.room != room) continue;
+        w.rating = match_policy == MatchPolicy::Hp ? p.hp : p.win_ratio();
+        ready.push_back(w);
+    }
+    MatchQueue::order_for_pairing(ready, match_policy);
+
+    const auto now = MatchQueue::Clock::now();
+    vector<TimerWheel::Callback> timeouts;
+    vector<pair<shared_ptr<Player>, shared_ptr<Player>>> matches;
+    size_t i = 0;
+    for (; i + 1 < ready.size(); i += 2) {
+        const auto& wait_a = ready[i];
+        const auto& wait_b = ready[i + 1];
+        shared_ptr<Player> a = *room->members().find(wait_a.player_id);
+        shared_ptr<Player> b = *room->members().find(wait_b.player_id);
+        auto lock = registry.lock_pair(a->id, b->id);
+        if (a->in_match || b->in_match || a->challenged_by != -1 || b->challenged_by != -1) {
+            // Busy with a /challenge; try again next tick.
+            room->match_queue.requeue(wait_a);
+            room->match_queue.requeue(wait_b);
+            continue;
+        }
+        const int challenge_id = ++global_challenge_id;
+        for (Player* p : {a.get(), b.get()}) {
+            p->in_match = true;
+            p->pending_choice = '\0';
+            p->challenge_responded = false;
+            p->challenge_id = challenge_id;
+        }
+        a->challenged_by = b->id;
+        b->challenged_by = a->id;
+        timeouts.push_back([room, a, b, challenge_id] {
+            boost::asio::post(room->strand(), [room, a, b, challenge_id] {
+                challenge_timeout(room, a, b, challenge_id);
+            });
+        });
+        matches.emplace_back(a, b);
+        Metrics::observe(Histogram::QueueWait, now - wait_a.since);
+        Metrics::observe(Histogram::QueueWait, now - wait_b.since);
+    }
+    if (i < ready.size()) room->match_queue.requeue(ready[i]);
+    Metrics::record(Histogram::MatchesPerTick, matches.size());
+    if (matches.empty()) return;
+    Metrics::add(Counter::MatchesFormed, matches.size());
+
+    auto ids = challenge_timers->schedule_batch(CHALLENGE_TIMEOUT, std::move(timeouts));
+    for (size_t m = 0; m < matches.size(); ++m) {
+        auto& [a, b] = matches[m];
+        {
+            auto lock = registry.lock_pair(a->id, b->id);
+            a->challenge_timer = ids[m];
+            b->challenge_timer = ids[m];
+        }
+        string msg = "Match found: " + a->name + " vs " + b->name + ". Send /move <R|P|S> within "
+                     + to_string(CHALLENGE_TIMEOUT.count()) + " seconds.\n";
+        auto buffer = MessageBuffer::make(msg);
+        if (a->session) a->session->deliver(buffer);
+        if (b->session) b->session->deliver(buffer);
+    }
+}
+
+// Every tick, runs a pass in each room that has players queued.
+void schedule_matchmaking(boost::asio::steady_timer& timer, chrono::milliseconds tick) {
+    timer.expires_after(tick);
+    timer.async_wait([&timer, tick](const boost::system::error_code& ec) {
+        if (ec) return;
+        for (auto& room : rooms->list()) {
+            if (room->match_queue.size() < 2) continue;
+            boost::asio::post(room->strand(), [room] { form_matches(room); });
+        }
+        schedule_matchmaking(timer, tick);
+    });
+}
+
+void enter_room(const shared_ptr<Room>& room, const shared_ptr<Player>& player);
+
+// Strand of `room`. Takes the player out of the room and announces it.
+void leave_room(const shared_ptr<Room>& room, const shared_ptr<Player>& player, const string& leave_msg) {
+    room->remove_member(player->id);
+    room->match_queue.remove(player->id);
+    mark_status_departed(*room, player->name);
+    room->broadcast(leave_msg);
+    rooms->remove_if_empty(*room);
+}
+
+// Strand of `from`. Moves the player to `to` unless they are mid-match; their
+// commands follow player->room, so anything sent after this runs on `to`. If
+// the move goes ahead, `queue` is the mode whose queue they join on arrival.
+void move_to_room(const shared_ptr<Room>& from, const shared_ptr<Player>& player, const shared_ptr<Room>& to,
+                  GameMode queue = GameMode::NONE) {
+    if (from == to) {
+        send_to(player, "You are already in room " + to_string(to->id()) + ".\n");
+        return;
+    }
+    {
+        auto lock = registry.lock(player->id);
+        // A player killed by timeout keeps in_match so nobody challenges them,
+        // but has no match left to finish.
+        const bool dead = player->hp <= 0;
+        if (!dead && (player->in_match || player->challenged_by != -1)) {
+            send_to(player, "You cannot switch modes while in a match!\n");
+            return;
+        }
+        if (dead) {
+            player->in_match = false;
+            player->challenged_by = -1;
+        }
+        player->room = to;
+        player->queue_on_enter = queue;
+    }
+    leave_room(from, player, player->name + " left the room.\n");
+    boost::asio::post(to->strand(), [to, player] { enter_room(to, player); });
+}
 
+// Strand of `room`.
+void enter_room(const shared_ptr<Room>& room, const shared_ptr<Player>& player) {
+    if (room->retired || !room->open()) {
+        send_to(player, "Room " + to_string(room->id()) + " is not open.\n");
+        auto lobby = rooms->lobby();
+        {
+            auto lock = registry.lock(player->id);
+            player->room = lobby;
+        }
+        boost::asio::post(lobby->strand(), [lobby, player] { enter_room(lobby, player); });
+        return;
+    }
     {
-        // This ensures only one thread at a time can modify or read from players.
-        lock_guard<mutex> lock(players_mutex);
-        players.emplace(player_id, player);
+        auto lock = registry.lock(player->id);
+        if (player->room != room) return;  // disconnected or moved on meanwhile
+        player->mode = room->mode();
+        if (room->mode() != GameMode::NONE) player->hp = room->rules().initial_hp;
     }
+    room->add_member(player);
+    mark_status_dirty(*room, player->id);
 
-    string join_msg = player->name + " joined the chat.\n";
-    broadcast(join_msg, socket);
-    cout << "Player " << player->name << " joined the chat." << endl << std::flush; 
+    if (room->mode() == GameMode::NONE) {
+        room->broadcast(player->name + " joined the chat.\n", player->session);
+    } else {
+        send_to(player, "Joined room " + to_string(room->id()) + " (" + room->name() + ", " +
+                        mode_name(room->mode()) + ")\n");
+        room->broadcast(player->name + " joined in mode: " + mode_name(room->mode()) + "\n", player->session);
+    }
+    send_full_status(*room, player);
 
-    string welcome = "Rock-Paper-Scissors Battle Arena\n";
-    boost::asio::write(*socket, boost::asio::buffer(welcome));
-    
-    try {
-        while (true) {
-            boost::asio::read_until(*socket, buffer, '\n');
-            string msg;
-            getline(input, msg);
-
-            if (!msg.empty()) {
-
-                if (msg.rfind("/mode", 0) == 0) {
-                    if (player->in_match || player->challenged_by != -1) {
-                        string err = "You cannot switch modes while in a match!\n";
-                        boost::asio::write(*socket, boost::asio::buffer(err));
-                        continue;
-                    }
-                    istringstream ss(msg);
-                    string cmd, mode_choice;
-                    ss >> cmd >> mode_choice;
-
-                    if (mode_choice == "deathmatch") {
-                        player->mode = GameMode::DEATHMATCH;
-                        selected_mode = GameMode::DEATHMATCH;
-                        deathmatch_players_connected++;
-
-                        if (deathmatch_players_connected >= 2 && !deathmatch_game_started) {
-                            deathmatch_game_started = true;
-                            broadcast("Deathmatch: At least 2 players connected. Game starting!\n", nullptr);
-                        }
-                    } else if (mode_choice == "lms") {
-                        player->mode = GameMode::LAST_MAN_STANDING;
-                        selected_mode = GameMode::LAST_MAN_STANDING;
-                        player->hp = INITIAL_HP;
-                        lms_players_connected++;
-                        if (lms_players_connected == LMS_NUM_PLAYERS) {
-                            lms_game_started = true;
-                            broadcast("LMS: All players connected. Game starting!\n", nullptr);
-                        }
-                    }
-                    string join_msg = player->name + " joined in mode: " + mode_choice + "\n";
-                    broadcast(join_msg, socket);
+    GameMode queued;
+    {
+        auto lock = registry.lock(player->id);
+        queued = exchange(player->queue_on_enter, GameMode::NONE);
+    }
+    if (queued != GameMode::NONE && queued == room->mode()) enqueue_player(room, player);
+
+    if (room->mode() == GameMode::DEATHMATCH && room->member_count() >= 2 && !room->started()) {
+        room->set_started(true);
+        room->broadcast("Deathmatch: At least 2 players connected. Game starting!\n");
+    } else if (room->mode() == GameMode::LAST_MAN_STANDING && !room->started()
+               && room->member_count() == static_cast<size_t>(room->rules().lms_players)) {
+        room->set_started(true);
+        room->broadcast("LMS: All players connected. Game starting!\n");
+    }
+}
+
+GameMode parse_mode(string_view name) {
+    if (name == "deathmatch") return GameMode::DEATHMATCH;
+    if (name == "lms") return GameMode::LAST_MAN_STANDING;
+    return GameMode::NONE;
+}
+
+// The parts of a parsed Command a room handler needs, owned, so it can be
+// queued onto the room strand after the receive buffer has moved on. Only
+// chat and /room create carry text.
+struct RoomCommand {
+    CommandType type;
+    int number;
+    char move;
+    GameMode mode;
+    string text;
+};
+
+// While the server is overloaded nobody starts anything new; leaving for the
+// lobby is always allowed.
+bool refuse_join(const shared_ptr<Player>& player) {
+    if (!Session::overloaded()) return false;
+    Metrics::add(Counter::JoinsRefused);
+    send_to(player, "The server is busy; try joining again in a moment.\n");
+    return true;
+}
+
+// Runs on the room strand for every command from a player in that room.
+void handle_room_command(const shared_ptr<Room>& room, const shared_ptr<Player>& player, const RoomCommand& cmd) {
+    const int player_id = player->id;
+    const shared_ptr<Session>& session = player->session;
+
+    // Command: /mode <deathmatch|lms> joins (or opens) a room of that mode.
+    if (cmd.type == CommandType::Mode) {
+        GameMode mode = cmd.mode;
+        if (room->mode() == mode) {
+            send_to(player, "You are already in room " + to_string(room->id()) + ".\n");
+            return;
+        }
+        if (refuse_join(player)) return;
+        auto target = rooms->find_open(mode);
+        if (!target) target = rooms->create(mode, "");
+        move_to_room(room, player, target);
+    }
+    // Command: /queue <deathmatch|lms|leave> waits for the matchmaker to pair
+    // this player with someone in a room of that mode.
+    else if (cmd.type == CommandType::Queue) {
+        if (cmd.mode == GameMode::NONE) {
+            send_to(player, room->match_queue.remove(player_id) ? "Left the queue.\n" : "You are not queued.\n");
+            return;
+        }
+        if (room->mode() == cmd.mode) {
+            enqueue_player(room, player);
+            return;
+        }
+        if (refuse_join(player)) return;
+        auto target = rooms->find_open(cmd.mode);
+        if (!target) target = rooms->create(cmd.mode, "");
+        move_to_room(room, player, target, cmd.mode);
+    }
+    // Command: /login <name> takes on a named identity, restoring its saved
+    // stats (or saving the current ones under a new name).
+    else if (cmd.type == CommandType::Login) {
+        if (!player_store) {
+            send_to(player, "This server doesn't keep stats; start it with --data-dir to enable /login.\n");
+            return;
+        }
+        if (room->mode() != GameMode::NONE) {
+            send_to(player, "Log in from the lobby (/room leave).\n");
+            return;
+        }
+        const string& name = cmd.text;
+        {
+            lock_guard<mutex> lock(online_names_mutex);
+            if (!online_names.insert(name).second) {
+                send_to(player, "The name " + name + " is already playing.\n");
+                return;
+            }
+        }
+        PlayerStore::Stats saved;
+        const bool known = player_store->load(name, saved);
+        string old_name;
+        bool was_persistent;
+        {
+            auto lock = registry.lock(player_id);
+            if (player->in_match) {
+                lock.unlock();
+                {
+                    lock_guard<mutex> names(online_names_mutex);
+                    online_names.erase(name);
                 }
-                // Command: /challenge <id> <R|P|S>
-                else if (msg.rfind("/challenge", 0) == 0) {
-                    istringstream ss(msg);
-                    string cmd;
-                    int target_id;
-                    char move;
-                    ss >> cmd >> target_id >> move;
-
-                    lock_guard<mutex> lock(players_mutex);
-                    if (players.count(target_id) && players[target_id]->hp > 0) {
-                        if (target_id == player->id) {
-                            boost::asio::write(*socket, boost::asio::buffer("You can't challenge yourself.\n"));
-                            continue;
-                        }
-                        if (players[target_id]->in_match || player->in_match || player->hp <= 0 || players[target_id]->hp <= 0) {
-                            string err_msg = "Cannot challenge. Player is busy or dead. " + players[target_id]->name + " is currently in a match or dead.\n";
-                            boost::asio::write(*socket, boost::asio::buffer(err_msg));
-                        } else {
-                            auto target = players[target_id];
-                            player->challenged_by = target_id;
-                            target->challenged_by = player_id;
-                            player->in_match = true;
-                            target->in_match = true;
-                            player->pending_choice = move;
-                            target->challenge_responded = false;
-                            int challenge_id = ++global_challenge_id;
-                            player->challenge_id = challenge_id;
-                            target->challenge_id = challenge_id;
-                        
-                            // Start a timeout thread
-                            thread(challenge_timeout, player, target, challenge_id).detach();
-
-                            // Send challenge message
-                            string challenge_msg = "Challenge: " + player->name + " challenged you to a game. Timeout in 10 seconds\n";
-                            boost::asio::write(*target->socket, boost::asio::buffer(challenge_msg));
-                        }
-                    }
-                
+                send_to(player, "Finish your match first.\n");
+                return;
+            }
+            old_name = player->name;
+            was_persistent = player->persistent;
+            if (known) {
+                player->num_games_played = saved.games_played;
+                player->games_won = saved.games_won;
+                player->hp = saved.hp;
+                player->current_winstreak = saved.winstreak;
+            }
+            player->name = name;
+            player->persistent = true;
+            record_result(*player);
+        }
+        if (was_persistent) {
+            lock_guard<mutex> lock(online_names_mutex);
+            online_names.erase(old_name);
+        }
+        mark_status_departed(*room, old_name);
+        mark_status_dirty(*room, player_id);
+        send_to(player, known ? "Welcome back, " + name + " (" + to_string(saved.games_played) + " games, "
+                                    + to_string(saved.games_won) + " won).\n"
+                              : "Logged in as " + name + ". Your stats will be kept.\n");
+        room->broadcast(old_name + " is now " + name + ".\n", session);
+    }
+    // Command: /room create <deathmatch|lms> [name]
+    else if (cmd.type == CommandType::RoomCreate) {
+        if (refuse_join(player)) return;
+        move_to_room(room, player, rooms->create(cmd.mode, cmd.text));
+    }
+    // Command: /room join <id>
+    else if (cmd.type == CommandType::RoomJoin) {
+        auto target = rooms->find(cmd.number);
+        if (!target) {
+            send_to(player, "No such room.\n");
+            return;
+        }
+        if (refuse_join(player)) return;
+        move_to_room(room, player, target);
+    }
+    // Command: /room leave
+    else if (cmd.type == CommandType::RoomLeave) {
+        move_to_room(room, player, rooms->lobby());
+    }
+    // Command: /challenge <id> <R|P|S>
+    else if (cmd.type == CommandType::Challenge) {
+        const int target_id = cmd.number;
+        const char move = cmd.move;
+        auto lock = registry.lock_pair(player_id, target_id);
+        auto target = registry.find_locked(target_id);
+        if (target && target->room != room) {
+            send_to(player, target->name + " is not in your room.\n");
+            return;
+        }
+        if (target && target->hp > 0) {
+            if (target_id == player->id) {
+                send_to(player, "You can't challenge yourself.\n");
+                return;
             }
-                // Command: /move <R|P|S>
-                else if (msg.rfind("/move", 0) == 0) {
-                    istringstream ss(msg);
-                    string cmd;
-                    char reply_move;
-                    ss >> cmd >> reply_move;
-
-                    string summary;
-                    string kill_msg1, kill_msg2, killstreak_msg;
-                    bool should_broadcast = false;
-                    bool broadcast_status = false;
-                    shared_ptr<Player> challenger;
-                    char initiator_move;
-                    string result;
-                    {
-                        lock_guard<mutex> lock(players_mutex);
-                        if (player->challenged_by != -1) {
-                            challenger = players[player->challenged_by];
-                            initiator_move = challenger->pending_choice;
-
-                        if (initiator_move == reply_move) result = "draw";
-                        else if ((initiator_move == 'R' && reply_move == 'S') ||
-                                (initiator_move == 'P' && reply_move == 'R') ||
-                                (initiator_move == 'S' && reply_move == 'P')) {
-                            result = "initiator";
-                        } else {
-                            result = "challenged";
-                        }
-
-                        challenger->num_games_played++;
-                        player->num_games_played++;
-
-                        if (selected_mode == GameMode::LAST_MAN_STANDING && lms_game_started) {
-                            if (result == "initiator") {
-                                player->hp--;
-                                challenger->current_winstreak++;
-                                player->current_winstreak = 0;
-                                challenger->games_won++;
-
-                                if (challenger->current_winstreak == 3 && challenger->hp > 0) {
-                                    challenger->hp++;
-                                    killstreak_msg = "🔥 Killing Spree! " + challenger->name + " gains +1 HP! 🔥\n";
-                                    challenger->current_winstreak = 0;
-                                }
-                            } else if (result == "challenged") {
-                                challenger->hp--;
-                                player->current_winstreak++;
-                                challenger->current_winstreak = 0;
-                                player->games_won++;
-
-                                if (player->current_winstreak == 3 && player->hp > 0) {
-                                    player->hp++;
-                                    killstreak_msg = "🔥 Killing Spree! " + player->name + " gains +1 HP! 🔥\n";
-                                    player->current_winstreak = 0;
-                                }
-                            } else {
-                                challenger->current_winstreak = 0;
-                                player->current_winstreak = 0;
-                            }
-                                if (challenger->hp <= 0) kill_msg1 = challenger->name + " has died.\n";
-                                if (player->hp <= 0) kill_msg2 = player->name + " has died.\n";
-
-                        } else {
-                            if (result == "initiator") challenger->games_won++;
-                            else if (result == "challenged") player->games_won++;
-                        }
-
-                        summary = "Match Result: " + challenger->name + " (" + initiator_move + ") vs "
-                            + player->name + " (" + reply_move + ") — "
-                            + (result == "draw" ? "It's a draw!" :
-                            (result == "initiator" ? challenger->name + " wins!" : player->name + " wins!")) + "\n";
-
-                        // Reset match state
-                        challenger->in_match = false;
-                        player->in_match = false;
-                        challenger->pending_choice = '\0';
-                        player->challenged_by = -1;
-                        challenger->challenge_responded = false;
-                        player->challenge_responded = true;
-
-                        should_broadcast = true;
-                        broadcast_status = true;
-                        }
-                    } 
-                    if (should_broadcast) {
-                        broadcast(summary, nullptr);
-                        if (!killstreak_msg.empty()) broadcast(killstreak_msg, nullptr);
-                        if (!kill_msg1.empty()) broadcast(kill_msg1, nullptr);
-                        if (!kill_msg2.empty()) broadcast(kill_msg2, nullptr);
-                        check_lms_game_end();
-                    }
-                    if (broadcast_status) {
-                        broadcast_player_status();
-                    }
+            if (target->in_match || player->in_match || player->hp <= 0 || target->hp <= 0) {
+                string err_msg = "Cannot challenge. Player is busy or dead. " + target->name + " is currently in a match or dead.\n";
+                send_to(player, err_msg);
+            } else {
+                player->challenged_by = target_id;
+                target->challenged_by = player_id;
+                player->in_match = true;
+                target->in_match = true;
+                player->pending_choice = move;
+                target->challenge_responded = false;
+                int challenge_id = ++global_challenge_id;
+                player->challenge_id = challenge_id;
+                target->challenge_id = challenge_id;
+
+                player->challenge_timer = challenge_timers->schedule(CHALLENGE_TIMEOUT,
+                    [room, player, target, challenge_id] {
+                        boost::asio::post(room->strand(), [room, player, target, challenge_id] {
+                            challenge_timeout(room, player, target, challenge_id);
+                        });
+                    });
+
+                // Send challenge message
+                string challenge_msg = "Challenge: " + player->name + " challenged you to a game. Timeout in 10 seconds\n";
+                send_to(target, challenge_msg);
+            }
+        }
+    }
+    // Command: /move <R|P|S>
+    else if (cmd.type == CommandType::Move) {
+        ScopedTimer timer(Histogram::MoveResolution);
+        const char reply_move = cmd.move;
+
+        string summary, waiting_msg;
+        string kill_msg1, kill_msg2, killstreak_msg;
+        bool should_broadcast = false;
+        shared_ptr<Player> challenger;
+        char initiator_move;
+        const bool lms = lms_active(*room);
+        int challenger_id;
+        {
+            auto lock = registry.lock(player_id);
+            challenger_id = player->challenged_by;
+        }
+        if (challenger_id != -1) {
+            // Both players' shards, in protocol order; re-check the match since
+            // the own-shard lock was released in between.
+            auto lock = registry.lock_pair(challenger_id, player_id);
+            challenger = registry.find_locked(challenger_id);
+            const bool live = challenger && player->challenged_by == challenger_id
+                              && challenger->challenged_by == player_id && player->in_match
+                              && challenger->in_match && player->challenge_id == challenger->challenge_id;
+            if (live && challenger->pending_choice == '\0') {
+                // The other side hasn't moved yet (a queued match, or a
+                // challenger answering their own challenge): lock this move in.
+                if (player->pending_choice == '\0') {
+                    player->pending_choice = reply_move;
+                    waiting_msg = "Move locked in. Waiting for " + challenger->name + ".\n";
+                } else {
+                    waiting_msg = "You already chose your move. Waiting for " + challenger->name + ".\n";
                 }
-                // Otherwise: treat it as chat
-                else {
-                    string full_msg = "[" + player->name + "]: " + msg + "\n";
-                    broadcast(full_msg, socket);
+            } else if (live) {
+                initiator_move = challenger->pending_choice;
+                const Outcome outcome = resolve(initiator_move, reply_move);
+                const ResultEffects effects = apply_result(*room, lms, outcome, *challenger, *player);
+                if (effects.spree) {
+                    const string& winner = outcome == Outcome::FirstWins ? challenger->name : player->name;
+                    killstreak_msg = "🔥 Killing Spree! " + winner + " gains +1 HP! 🔥\n";
                 }
+                if (effects.first_died) kill_msg1 = challenger->name + " has died.\n";
+                if (effects.second_died) kill_msg2 = player->name + " has died.\n";
+
+            summary = "Match Result: " + challenger->name + " (" + initiator_move + ") vs "
+                + player->name + " (" + reply_move + ") — "
+                + (outcome == Outcome::Draw ? "It's a draw!" :
+                (outcome == Outcome::FirstWins ? challenger->name + " wins!" : player->name + " wins!")) + "\n";
+
+            // Reset match state; a queued match keeps its timer on both sides.
+            challenge_timers->cancel(challenger->challenge_timer);
+            challenge_timers->cancel(player->challenge_timer);
+            end_match(*challenger);
+            end_match(*player);
+            challenger->challenge_responded = false;
+            player->challenge_responded = true;
+            record_result(*challenger);
+            record_result(*player);
+
+            should_broadcast = true;
+            Metrics::add(Counter::MovesResolved);
+            } else if (!challenger && player->challenged_by == challenger_id) {
+                // The opponent disconnected and call_off_match hasn't run yet.
+                challenge_timers->cancel(player->challenge_timer);
+                end_match(*player);
+                waiting_msg = "Your opponent has left; the match is off.\n";
             }
         }
-    } catch (const std::exception& e) {
-        cerr << "Exception while handling client: " << e.what() << endl;
+        if (!waiting_msg.empty()) send_to(player, waiting_msg);
+        if (should_broadcast) {
+            mark_status_dirty(*room, challenger->id);
+            mark_status_dirty(*room, player->id);
+            room->broadcast(summary);
+            if (!killstreak_msg.empty()) room->broadcast(killstreak_msg);
+            if (!kill_msg1.empty()) room->broadcast(kill_msg1);
+            if (!kill_msg2.empty()) room->broadcast(kill_msg2);
+            if (lms) check_lms_game_end(*room);
+        }
+    }
+    // Command: /status (full snapshot on request)
+    else if (cmd.type == CommandType::Status) {
+        send_full_status(*room, player);
+    }
+    // Otherwise: treat it as chat
+    else if (cmd.type == CommandType::Chat) {
+        string full_msg = "[" + player->name + "]: " + cmd.text + "\n";
+        // Coalesced rather than fanned out line by line while overloaded; held
+        // lines also keep later ones behind them in order.
+        if (Session::overloaded() || !room->held_chat.empty()) {
+            hold_chat(*room, player_id, std::move(full_msg));
+            return;
+        }
+        room->broadcast(full_msg, session, MessageKind::Chat);
     }
+}
 
-    // Handle client disconnection or termination
-    string leave_msg = player->name + " left the chat.\n";
-    broadcast(leave_msg, socket);
+string format_room_list() {
+    string out = "[ROOMS]\n";
+    for (auto& room : rooms->list()) {
+        out += to_string(room->id()) + " | " + room->name() + " | " + mode_name(room->mode()) + " | "
+             + to_string(room->member_count()) + " players | "
+             + (room->started() ? "in progress" : (room->open() ? "waiting" : "full")) + "\n";
+    }
+    out += "[ROOMS_END]\n";
+    return out;
+}
+
+string format_leaderboard_row(const Leaderboard::Row& row) {
+    char ratio[16];
+    snprintf(ratio, sizeof(ratio), "%.2f", row.win_ratio());
+    return row.name + " | Won: " + to_string(row.games_won) + " | Games: " + to_string(row.games_played)
+           + " | Ratio: " + ratio;
+}
 
+string format_leaderboard(size_t k) {
+    string out = "[LEADERBOARD]\n";
+    for (const auto& row : leaderboard.top(k)) out += to_string(row.rank) + " | " + format_leaderboard_row(row) + "\n";
+    out += "[LEADERBOARD_END]\n";
+    return out;
+}
+
+string format_rank(int id) {
+    Leaderboard::Row row;
+    if (!leaderboard.rank(id, &row)) return "Player " + to_string(id) + " is not ranked.\n";
+    return "Rank " + to_string(row.rank) + " of " + to_string(leaderboard.size()) + ": "
+           + format_leaderboard_row(row) + "\n";
+}
+
+void dispatch_to_room(const shared_ptr<Player>& player, RoomCommand cmd) {
+    auto room = current_room(player);
+    if (!room) return;
+    boost::asio::dispatch(room->strand(), [room, player, cmd = std::move(cmd)]() mutable {
+        // The player may have switched rooms after this was queued; follow them.
+        if (current_room(player) != room) {
+            dispatch_to_room(player, std::move(cmd));
+            return;
+        }
+        handle_room_command(room, player, cmd);
+    });
+}
 
+// Runs on the player's session strand for every complete line the client
+// sends. `line` points into the receive buffer.
+void handle_line(const shared_ptr<Player>& player, string_view line) {
+    const Command cmd = parse_command(line);
+    if (!player->limiter.allow(command_class(cmd.type))) {
+        Metrics::add(Counter::LinesRateLimited);
+        if (player->limiter.take_warning()) send_to(player, "Slow down: messages are being dropped.\n");
+        return;
+    }
+    switch (cmd.type) {
+        // Commands that don't touch room state are answered right here.
+        case CommandType::Stats: {
+            auto lag = challenge_timers->lag_stats();
+            ostringstream oss;
+            oss << "[STATS] pending_challenge_timers=" << challenge_timers->pending()
+                << " timers_fired=" << lag.fired
+                << " timer_lag_avg_us=" << (lag.fired ? lag.total_lag_us / lag.fired : 0)
+                << " timer_lag_max_us=" << lag.max_lag_us
+                << " dropped_status_messages=" << Session::dropped_status_messages()
+                << " slow_reader_disconnects=" << Session::slow_reader_disconnects() << "\n";
+            send_to(player, oss.str());
+            return;
+        }
+        case CommandType::RoomList:
+            send_to(player, format_room_list());
+            return;
+        case CommandType::Leaderboard:
+            send_to(player, format_leaderboard(cmd.number < 0 ? 10 : static_cast<size_t>(cmd.number)));
+            return;
+        case CommandType::Rank:
+            send_to(player, format_rank(cmd.number < 0 ? player->id : cmd.number));
+            return;
+        case CommandType::Invalid:
+            send_to(player, string(cmd.text) + "\n");
+            return;
+        default:
+            break;
+    }
+    dispatch_to_room(player, RoomCommand{cmd.type, cmd.number, cmd.move, parse_mode(cmd.word), string(cmd.text)});
+}
+
+// Strand of `room`. `gone` has disconnected: the match they were in ends
+// with no result, so their opponent neither waits out the timer nor loses on
+// time.
+void call_off_match(Room& room, const shared_ptr<Player>& gone) {
+    int opponent_id;
     {
-        lock_guard<mutex> lock(players_mutex);
-        players.erase(player_id);
+        auto lock = registry.lock(gone->id);
+        opponent_id = gone->challenged_by;
     }
+    if (opponent_id == -1) return;
+    auto found = room.members().find(opponent_id);
+    if (!found) return;
+    shared_ptr<Player> opponent = *found;
+    string name;
+    {
+        auto lock = registry.lock_pair(gone->id, opponent_id);
+        const TimerWheel::TimerId timers[] = {gone->challenge_timer, opponent->challenge_timer};
+        if (!abandon_match(*gone, *opponent)) return;
+        for (auto timer : timers) challenge_timers->cancel(timer);
+        name = gone->name;
+    }
+    send_to(opponent, name + " has left; the match is off.\n");
 }
 
-int main() {
-    try {
-        boost::asio::io_service io_service;
+void handle_disconnect(const shared_ptr<Player>& player) {
+    registry.erase(player->id);
+    leaderboard.remove(player->id);
+    shared_ptr<Room> room;
+    string name;
+    {
+        auto lock = registry.lock(player->id);
+        room = std::move(player->room);
+        if (player->persistent) name = player->name;
+    }
+    if (!name.empty()) {
+        lock_guard<mutex> lock(online_names_mutex);
+        online_names.erase(name);
+    }
+    if (!room) return;
+    boost::asio::post(room->strand(), [room, player] {
+        // Handle client disconnection or termination
+        call_off_match(*room, player);
+        leave_room(room, player, player->name + " left the chat.\n");
+    });
+}
 
-        tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), 12345));
-        std::cout << "Server listening on port 12345..." << std::endl;
+void handle_connect(shared_ptr<Session> session) {
+    // Register the player
+    auto player = make_shared<Player>();
+    player->id = session->id();
+    player->name = string(PlayerStore::kGuestPrefix) + to_string(player->id);
+    player->session = session;
+    auto lobby = rooms->lobby();
+    player->room = lobby;
 
-        int player_id = 1;
+    registry.insert(player);
+    leaderboard.update(player->id, player->name, 0, 0);
+    cout << "Player " << player->name << " joined the chat." << endl << std::flush;
 
-        //Inside an infinite loop, the server waits for new clients, Player threads can keep playing even if server loop continues.
-        while (true) {
-            shared_ptr<tcp::socket> socket = make_shared<tcp::socket>(io_service);
-            acceptor.accept(*socket);
+    send_to(player, "Rock-Paper-Scissors Battle Arena\n");
+    send_to(player, "You are " + player->name + " (ID " + to_string(player->id) + ").\n");
+    if (player_store) send_to(player, "Use /login <name> to keep your stats between visits.\n");
+    boost::asio::post(lobby->strand(), [lobby, player] { enter_room(lobby, player); });
 
-            // Handle each client connection in a separate thread
-            thread(handle_client, socket, player_id++).detach();
+    session->start([player](string_view line) { handle_line(player, line); },
+                   [player] { handle_disconnect(player); });
+}
+
+// Everything for a Prometheus scrape: the hot-path metrics plus the counters
+// other modules already keep.
+string render_metrics() {
+    string out;
+    Metrics::render(out);
+    auto lag = challenge_timers->lag_stats();
+    auto pool = MessageBuffer::pool_stats();
+    Metrics::render_value(out, "rps_connected_players", "Players in the registry.", "gauge",
+                          static_cast<double>(registry.size()));
+    Metrics::render_value(out, "rps_leaderboard_cache_rebuilds_total", "Times the top-K cache was rebuilt.",
+                          "counter", static_cast<double>(leaderboard.cache_rebuilds()));
+    Metrics::render_value(out, "rps_rooms", "Open rooms, lobby included.", "gauge",
+                          static_cast<double>(rooms->list().size()));
+    Metrics::render_value(out, "rps_pending_challenge_timers", "Challenges waiting for a reply.", "gauge",
+                          static_cast<double>(challenge_timers->pending()));
+    Metrics::render_value(out, "rps_timers_fired_total", "Timer wheel callbacks fired.", "counter",
+                          static_cast<double>(lag.fired));
+    Metrics::render_value(out, "rps_dropped_status_messages_total", "Status messages shed for slow readers.",
+                          "counter", static_cast<double>(Session::dropped_status_messages()));
+    Metrics::render_value(out, "rps_slow_reader_disconnects_total", "Sessions dropped for not reading.", "counter",
+                          static_cast<double>(Session::slow_reader_disconnects()));
+    Metrics::render_value(out, "rps_queued_outbound_bytes", "Unsent bytes across all sessions.", "gauge",
+                          static_cast<double>(Session::total_queued_bytes()));
+    Metrics::render_value(out, "rps_message_buffers_pooled_total", "Message buffers served from the pool.",
+                          "counter", static_cast<double>(pool.pooled_allocations));
+    Metrics::render_value(out, "rps_message_buffers_heap_total", "Message buffers allocated on the heap.",
+                          "counter", static_cast<double>(pool.heap_allocations));
+    if (player_store) {
+        auto store = player_store->counters();
+        Metrics::render_value(out, "rps_store_snapshot_records", "Named players in the mapped snapshot.", "gauge",
+                              static_cast<double>(store.snapshot_records));
+        Metrics::render_value(out, "rps_store_log_records", "Records appended to the log since the snapshot.",
+                              "gauge", static_cast<double>(store.log_records));
+        Metrics::render_value(out, "rps_store_batches_written_total", "Batched appends to the player log.",
+                              "counter", static_cast<double>(store.batches_written));
+        Metrics::render_value(out, "rps_store_compactions_total", "Player log compactions into a snapshot.",
+                              "counter", static_cast<double>(store.compactions));
+    }
+    return out;
+}
+
+// Over the connection cap or overloaded: line-protocol clients are told why,
+// WebSocket clients (mid-handshake) are just closed.
+template <typename SessionType>
+void refuse_connection(tcp::socket socket) {
+    Metrics::add(Counter::ConnectionsRefused);
+    auto sock = make_shared<tcp::socket>(std::move(socket));
+    auto close = [sock] {
+        boost::system::error_code ignored;
+        sock->shutdown(tcp::socket::shutdown_both, ignored);
+        sock->close(ignored);
+    };
+    if constexpr (is_same_v<SessionType, TcpSession>) {
+        static const string kFull = "Server full, try again later.\n";
+        boost::asio::async_write(*sock, boost::asio::buffer(kFull),
+                                 [close](const boost::system::error_code&, size_t) { close(); });
+    } else {
+        close();
+    }
+}
+
+// SessionType picks the transport; both listeners share one ID sequence.
+template <typename SessionType>
+void do_accept(tcp::acceptor& acceptor, boost::asio::io_context& io_context, atomic<int>& player_id) {
+    // Every accepted socket gets its own strand.
+    acceptor.async_accept(boost::asio::make_strand(io_context),
+        [&acceptor, &io_context, &player_id](const boost::system::error_code& ec, tcp::socket socket) {
+            if (!ec && (Session::full() || Session::overloaded())) {
+                refuse_connection<SessionType>(std::move(socket));
+            } else if (!ec) {
+                handle_connect(make_shared<SessionType>(std::move(socket), player_id++));
+            } else if (ec != boost::asio::error::operation_aborted) {
+                cerr << "Accept error: " << ec.message() << endl;
+            }
+            if (acceptor.is_open()) do_accept<SessionType>(acceptor, io_context, player_id);
+        });
+}
+
+// The default --max-connections for an open-file limit: that limit less a few
+// descriptors for the listeners, the store and the metrics endpoint. Past it
+// accept() fails with EMFILE anyway, so the cap never turns away a player the
+// server could have held, and those it does turn away hear "Server full"
+// instead of being reset. 0 (no cap) when the limit is unknown or unlimited.
+size_t connection_cap(rlim_t open_files) {
+    constexpr rlim_t kReserved = 64;
+    if (open_files == 0 || open_files == RLIM_INFINITY) return 0;
+    return open_files > 2 * kReserved ? static_cast<size_t>(open_files - kReserved)
+                                      : static_cast<size_t>(open_files / 2);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned short port = 12345;
+    unsigned short ws_port = 8081;
+    unsigned short metrics_port = 9464;
+    unsigned num_threads = max(1u, thread::hardware_concurrency());
+    OutboundLimits outbound;
+    AdmissionLimits admission;
+    bool max_connections_given = false;
+    RateLimits rate_limits;
+    chrono::milliseconds status_tick(50);
+    chrono::milliseconds match_tick(200);
+    string data_dir;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = static_cast<unsigned short>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metrics_port = static_cast<unsigned short>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--ws-port") == 0 && i + 1 < argc) {
+            ws_port = static_cast<unsigned short>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--status-tick") == 0 && i + 1 < argc) {
+            status_tick = chrono::milliseconds(max(1, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--data-dir") == 0 && i + 1 < argc) {
+            data_dir = argv[++i];
+        } else if (strcmp(argv[i], "--match-tick") == 0 && i + 1 < argc) {
+            match_tick = chrono::milliseconds(max(1, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--match-by") == 0 && i + 1 < argc) {
+            string policy = argv[++i];
+            if (policy == "fifo") match_policy = MatchPolicy::Fifo;
+            else if (policy == "ratio") match_policy = MatchPolicy::WinRatio;
+            else if (policy == "hp") match_policy = MatchPolicy::Hp;
+            else {
+                cerr << "Unknown --match-by policy: " << policy << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-connections") == 0 && i + 1 < argc) {
+            admission.max_sessions = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+            max_connections_given = true;
+        } else if (strcmp(argv[i], "--max-queued-bytes") == 0 && i + 1 < argc) {
+            admission.max_queued_bytes = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--line-rate") == 0 && i + 1 < argc) {
+            double rate = atof(argv[++i]);
+            rate_limits.lines = Rate{rate, 2 * rate};
+        } else if (strcmp(argv[i], "--chat-rate") == 0 && i + 1 < argc) {
+            double rate = atof(argv[++i]);
+            rate_limits.classes[static_cast<size_t>(CommandClass::Chat)] = Rate{rate, 2 * rate};
+        } else if (strcmp(argv[i], "--high-water") == 0 && i + 1 < argc) {
+            outbound.high_water_bytes = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--slow-reader") == 0 && i + 1 < argc) {
+            string policy = argv[++i];
+            if (policy == "drop-status") outbound.policy = SlowReaderPolicy::DropStatus;
+            else if (policy == "disconnect") outbound.policy = SlowReaderPolicy::Disconnect;
+            else {
+                cerr << "Unknown --slow-reader policy: " << policy << endl;
+                return 1;
+            }
+        } else {
+            cerr << "Usage: " << argv[0] << " [--port N] [--ws-port N|0] [--metrics-port N|0] [--threads N] [--high-water BYTES]"
+                 << " [--slow-reader drop-status|disconnect] [--status-tick MS] [--match-tick MS]"
+                 << " [--match-by fifo|ratio|hp] [--data-dir DIR] [--max-connections N|0]"
+                 << " [--max-queued-bytes BYTES|0] [--line-rate PER_SEC|0] [--chat-rate PER_SEC|0]" << endl;
+            return 1;
         }
+    }
+
+    // Every connected player holds a descriptor, so take all the hard limit
+    // allows rather than stopping at the (often 1024) soft one.
+    rlimit fd_limit{};
+    if (getrlimit(RLIMIT_NOFILE, &fd_limit) == 0 && fd_limit.rlim_cur < fd_limit.rlim_max) {
+        rlimit raised = fd_limit;
+        raised.rlim_cur = fd_limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &raised) == 0) fd_limit = raised;
+    }
+    if (!max_connections_given) admission.max_sessions = connection_cap(fd_limit.rlim_cur);
+    if (admission.max_sessions) cout << "Accepting up to " << admission.max_sessions << " connections" << endl;
+    Session::set_outbound_limits(outbound);
+    Session::set_admission_limits(admission);
+    RateLimiter::set_limits(rate_limits);
 
+    // Named-player stats; restoring is a mmap plus replaying whatever the log
+    // gained since the last snapshot.
+    if (!data_dir.empty()) {
+        auto start = chrono::steady_clock::now();
+        player_store = make_unique<PlayerStore>(data_dir);
+        string error;
+        if (!player_store->open(error)) {
+            cerr << "Can't open player store: " << error << endl;
+            return 1;
+        }
+        auto counts = player_store->counters();
+        auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "Player store " << data_dir << ": " << counts.snapshot_records << " in snapshot, "
+             << counts.log_records << " replayed from log in " << elapsed << " ms" << endl;
+        player_store->start();
+    }
+
+    try {
+        boost::asio::io_context io_context;
+
+        tcp::acceptor acceptor(io_context, tcp::endpoint(tcp::v4(), port));
+        std::cout << "Server listening on port " << port << " with " << num_threads << " worker threads..." << std::endl;
+        // Browsers connect here directly; --ws-port 0 turns it off.
+        unique_ptr<tcp::acceptor> ws_acceptor;
+        if (ws_port != 0) {
+            ws_acceptor = make_unique<tcp::acceptor>(io_context, tcp::endpoint(tcp::v4(), ws_port));
+            std::cout << "WebSocket clients on port " << ws_port << std::endl;
+        }
+
+        rooms = make_unique<RoomManager>(io_context);
+        challenge_timers = make_unique<TimerWheel>(io_context, chrono::milliseconds(100), 1024);
+        challenge_timers->start();
+
+        // Prometheus text on loopback only; absent when built without RPS_METRICS.
+        unique_ptr<MetricsEndpoint> metrics_endpoint;
+        if (kMetricsEnabled && metrics_port != 0) {
+            metrics_endpoint = make_unique<MetricsEndpoint>(
+                io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), metrics_port), render_metrics);
+            metrics_endpoint->start();
+            std::cout << "Metrics on http://127.0.0.1:" << metrics_port << "/metrics" << std::endl;
+        }
+        Metrics::gauge_set(Gauge::WorkerThreads, num_threads);
+
+        boost::asio::steady_timer status_timer(boost::asio::make_strand(io_context));
+        schedule_status_flush(status_timer, status_tick);
+        boost::asio::steady_timer match_timer(boost::asio::make_strand(io_context));
+        schedule_matchmaking(match_timer, match_tick);
+
+        atomic<int> player_id{1};
+        do_accept<TcpSession>(acceptor, io_context, player_id);
+        if (ws_acceptor) do_accept<WebSocketSession>(*ws_acceptor, io_context, player_id);
+
+        boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);
+        signals.async_wait([&](const boost::system::error_code&, int) {
+            challenge_timers->stop();
+            status_timer.cancel();
+            match_timer.cancel();
+            if (metrics_endpoint) metrics_endpoint->stop();
+            io_context.stop();
+        });
+
+        // All sessions share this fixed pool; a connection costs a strand, not a thread.
+        vector<thread> workers;
+        for (unsigned i = 1; i < num_threads; ++i) {
+            workers.emplace_back([&io_context] { io_context.run(); });
+        }
+        io_context.run();
+        for (auto& t : workers) t.join();
+        // Timers, rooms and sessions all belong to io_context, so they must go
+        // first. Unhooking players from their rooms breaks the Room <-> Player
+        // references so dropping the manager frees everything.
+        challenge_timers.reset();
+        if (player_store) player_store->stop();
+        registry.for_each([](const shared_ptr<Player>& p) { p->room.reset(); });
+        registry.clear();
+        rooms.reset();
 
     } catch (const exception& e) {
         std::cerr << "Server exception: " << e.what() << std::endl;
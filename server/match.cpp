@@ -0,0 +1,42 @@
+#include "match.hpp"
+
+using namespace std;
+
+ResultEffects apply_result(bool lms, const RuleSet& rules, Outcome outcome, Player& first, Player& second) {
+    Standing a{first.hp, first.current_winstreak, first.num_games_played, first.games_won};
+    Standing b{second.hp, second.current_winstreak, second.num_games_played, second.games_won};
+    ResultEffects effects = apply_result(lms, rules, outcome, a, b);
+    for (auto [p, s] : {pair<Player*, Standing*>{&first, &a}, {&second, &b}}) {
+        p->hp = s->hp;
+        p->current_winstreak = s->winstreak;
+        p->num_games_played = s->games_played;
+        p->games_won = s->games_won;
+    }
+    return effects;
+}
+
+void end_match(Player& p) {
+    p.in_match = false;
+    p.challenged_by = -1;
+    p.pending_choice = '\0';
+    p.challenge_timer = 0;
+}
+
+bool abandon_match(Player& gone, Player& other) {
+    const bool together = gone.in_match && other.in_match && gone.challenged_by == other.id
+                          && other.challenged_by == gone.id && gone.challenge_id == other.challenge_id;
+    if (!together) return false;
+    end_match(gone);
+    end_match(other);
+    other.challenge_responded = false;
+    return true;
+}
+
+ResultEffects settle_timeout(bool lms, const RuleSet& rules, Player& winner, Player& loser) {
+    const ResultEffects effects = apply_result(lms, rules, Outcome::FirstWins, winner, loser);
+    end_match(winner);
+    end_match(loser);
+    loser.challenge_responded = false;
+    loser.in_match = lms && effects.second_died;
+    return effects;
+}
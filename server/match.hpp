@@ -0,0 +1,24 @@
+#pragma once
+
+#include "player.hpp"
+#include "rules.hpp"
+
+// How a result and the end of a match change Player fields, with no locks,
+// timers or messages. Callers hold both players' shard locks (see main.cpp).
+
+// Runs the result through the rules engine and writes the standings back.
+ResultEffects apply_result(bool lms, const RuleSet& rules, Outcome outcome, Player& first, Player& second);
+
+// Clears everything that ties the player to their match: challenge, locked-in
+// move and timer id. The caller cancels the timer first if it may still fire.
+void end_match(Player& p);
+
+// `gone` has disconnected. If they and `other` are still in the same match,
+// releases both with no result and returns true; the caller cancels the
+// timers they held.
+bool abandon_match(Player& gone, Player& other);
+
+// The match timed out and only `winner` had locked in a move: they win it as
+// if they had won the throw and both players are released. An LMS player
+// killed this way stays in_match so nobody challenges them.
+ResultEffects settle_timeout(bool lms, const RuleSet& rules, Player& winner, Player& loser);
@@ -0,0 +1,42 @@
+#include "matchmaker.hpp"
+
+using namespace std;
+
+bool MatchQueue::enqueue(int player_id, Clock::time_point now) {
+    if (contains(player_id)) return false;
+    waiting_.push_back(Waiting{player_id, now});
+    size_.store(waiting_.size(), memory_order_relaxed);
+    return true;
+}
+
+bool MatchQueue::remove(int player_id) {
+    auto it = find_if(waiting_.begin(), waiting_.end(), [&](const Waiting& w) { return w.player_id == player_id; });
+    if (it == waiting_.end()) return false;
+    waiting_.erase(it);
+    size_.store(waiting_.size(), memory_order_relaxed);
+    return true;
+}
+
+bool MatchQueue::contains(int player_id) const {
+    return any_of(waiting_.begin(), waiting_.end(), [&](const Waiting& w) { return w.player_id == player_id; });
+}
+
+vector<MatchQueue::Waiting> MatchQueue::drain() {
+    vector<Waiting> out;
+    out.swap(waiting_);
+    size_.store(0, memory_order_relaxed);
+    return out;
+}
+
+void MatchQueue::requeue(const Waiting& waiting) {
+    // Keep oldest-first order: requeued entries waited longer than anyone
+    // who joined during the pass.
+    auto it = find_if(waiting_.begin(), waiting_.end(), [&](const Waiting& w) { return w.since > waiting.since; });
+    waiting_.insert(it, waiting);
+    size_.store(waiting_.size(), memory_order_relaxed);
+}
+
+void MatchQueue::order_for_pairing(vector<Waiting>& waiting, MatchPolicy policy) {
+    if (policy == MatchPolicy::Fifo) return;
+    stable_sort(waiting.begin(), waiting.end(), [](const Waiting& a, const Waiting& b) { return a.rating < b.rating; });
+}
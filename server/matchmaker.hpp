@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// How queued players are ordered before adjacent ones are paired.
+enum class MatchPolicy {
+    Fifo,      // longest-waiting first
+    WinRatio,  // similar win ratios meet
+    Hp,        // similar HP meet (useful in LMS)
+};
+
+// Players in one room waiting for /queue pairing. Touched only on the room's
+// strand, apart from size(), which the matchmaking tick reads to skip empty
+// rooms.
+class MatchQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Waiting {
+        int player_id;
+        Clock::time_point since;
+        double rating = 0;
+    };
+
+    // False if the player is already queued.
+    bool enqueue(int player_id, Clock::time_point now = Clock::now());
+    bool remove(int player_id);
+    bool contains(int player_id) const;
+    std::size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+    // Empties the queue, oldest first, for one pairing pass. Anyone who
+    // couldn't be matched goes back with requeue(), keeping their wait time.
+    std::vector<Waiting> drain();
+    void requeue(const Waiting& waiting);
+
+    // Orders drained entries so that each adjacent pair (0,1), (2,3), ... is a
+    // match; ratings must be filled in first. Stable, so ties stay FIFO.
+    static void order_for_pairing(std::vector<Waiting>& waiting, MatchPolicy policy);
+
+private:
+    std::vector<Waiting> waiting_;
+    std::atomic<std::size_t> size_{0};
+};
@@ -0,0 +1,146 @@
+#include "message_buffer.hpp"
+
+#include <array>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <new>
+
+using namespace std;
+
+namespace {
+
+// Payload capacities of the pooled size classes. Larger messages (full status
+// dumps on very busy servers) are allocated and freed directly.
+constexpr array<size_t, 4> kClassCapacity = {128, 512, 2048, 8192};
+constexpr uint32_t kUnpooled = numeric_limits<uint32_t>::max();
+// Each thread keeps a few blocks per class before handing them back to the
+// shared list, so the common alloc/free pair never takes a lock.
+constexpr size_t kLocalCacheLimit = 64;
+
+struct SharedFreeList {
+    mutex lock;
+    void* head = nullptr;
+};
+
+array<SharedFreeList, kClassCapacity.size()> shared_lists;
+atomic<uint64_t> pooled_allocations{0};
+atomic<uint64_t> heap_allocations{0};
+
+// A free block's first word links it to the next free block of its class.
+void*& next_free(void* block) { return *static_cast<void**>(block); }
+
+struct LocalCache {
+    array<void*, kClassCapacity.size()> head{};
+    array<size_t, kClassCapacity.size()> count{};
+
+    // Hand cached blocks back when a worker thread exits.
+    ~LocalCache() {
+        for (size_t i = 0; i < head.size(); ++i) {
+            while (head[i]) {
+                void* block = head[i];
+                head[i] = next_free(block);
+                lock_guard<mutex> lock(shared_lists[i].lock);
+                next_free(block) = shared_lists[i].head;
+                shared_lists[i].head = block;
+            }
+        }
+    }
+};
+thread_local LocalCache local_cache;
+
+}  // namespace
+
+MessageBuffer& MessageBuffer::operator=(const MessageBuffer& other) noexcept {
+    if (this != &other) {
+        other.retain();
+        release();
+        block_ = other.block_;
+    }
+    return *this;
+}
+
+MessageBuffer& MessageBuffer::operator=(MessageBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        block_ = other.block_;
+        other.block_ = nullptr;
+    }
+    return *this;
+}
+
+MessageBuffer MessageBuffer::make(string_view text) {
+    uint32_t size_class = kUnpooled;
+    for (uint32_t i = 0; i < kClassCapacity.size(); ++i) {
+        if (text.size() <= kClassCapacity[i]) {
+            size_class = i;
+            break;
+        }
+    }
+
+    Block* block = nullptr;
+    if (size_class != kUnpooled) {
+        auto& cache = local_cache;
+        if (cache.head[size_class]) {
+            block = static_cast<Block*>(cache.head[size_class]);
+            cache.head[size_class] = next_free(block);
+            cache.count[size_class]--;
+        } else {
+            auto& shared = shared_lists[size_class];
+            lock_guard<mutex> lock(shared.lock);
+            if (shared.head) {
+                block = static_cast<Block*>(shared.head);
+                shared.head = next_free(block);
+            }
+        }
+    }
+    if (block) {
+        pooled_allocations.fetch_add(1, memory_order_relaxed);
+    } else {
+        size_t capacity = size_class == kUnpooled ? text.size() : kClassCapacity[size_class];
+        block = static_cast<Block*>(::operator new(sizeof(Block) + capacity));
+        heap_allocations.fetch_add(1, memory_order_relaxed);
+    }
+
+    new (&block->refs) atomic<uint32_t>(1);
+    block->size = static_cast<uint32_t>(text.size());
+    block->size_class = size_class;
+    memcpy(reinterpret_cast<char*>(block + 1), text.data(), text.size());
+
+    MessageBuffer buffer;
+    buffer.block_ = block;
+    return buffer;
+}
+
+void MessageBuffer::release() {
+    if (block_ && block_->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+        recycle(block_);
+    }
+    block_ = nullptr;
+}
+
+void MessageBuffer::recycle(Block* block) {
+    const uint32_t size_class = block->size_class;
+    if (size_class == kUnpooled) {
+        ::operator delete(block);
+        return;
+    }
+    auto& cache = local_cache;
+    if (cache.count[size_class] < kLocalCacheLimit) {
+        next_free(block) = cache.head[size_class];
+        cache.head[size_class] = block;
+        cache.count[size_class]++;
+        return;
+    }
+    auto& shared = shared_lists[size_class];
+    lock_guard<mutex> lock(shared.lock);
+    next_free(block) = shared.head;
+    shared.head = block;
+}
+
+MessageBuffer::PoolStats MessageBuffer::pool_stats() {
+    PoolStats stats;
+    stats.pooled_allocations = pooled_allocations.load(memory_order_relaxed);
+    stats.heap_allocations = heap_allocations.load(memory_order_relaxed);
+    return stats;
+}
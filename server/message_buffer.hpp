@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Immutable, reference-counted bytes for the send path. A broadcast serializes
+// its text into one MessageBuffer and every recipient's queue holds a handle to
+// the same block, so fan-out costs a refcount bump per recipient instead of a
+// copy. Blocks come from size-classed free lists and go back there when the
+// last handle is dropped, on whichever thread that happens.
+class MessageBuffer {
+public:
+    struct PoolStats {
+        std::uint64_t pooled_allocations = 0;  // served from a free list
+        std::uint64_t heap_allocations = 0;    // fresh blocks, incl. oversized ones
+    };
+
+    MessageBuffer() = default;
+    MessageBuffer(const MessageBuffer& other) noexcept : block_(other.block_) { retain(); }
+    MessageBuffer(MessageBuffer&& other) noexcept : block_(other.block_) { other.block_ = nullptr; }
+    MessageBuffer& operator=(const MessageBuffer& other) noexcept;
+    MessageBuffer& operator=(MessageBuffer&& other) noexcept;
+    ~MessageBuffer() { release(); }
+
+    // The only copy of the payload the buffer will ever make.
+    static MessageBuffer make(std::string_view text);
+
+    const char* data() const { return block_ ? reinterpret_cast<const char*>(block_ + 1) : nullptr; }
+    std::size_t size() const { return block_ ? block_->size : 0; }
+    std::string_view view() const { return {data(), size()}; }
+    explicit operator bool() const { return block_ != nullptr; }
+
+    static PoolStats pool_stats();
+
+private:
+    struct Block {
+        std::atomic<std::uint32_t> refs;
+        std::uint32_t size;
+        std::uint32_t size_class;  // index into the pool, or kUnpooled
+    };
+
+    void retain() const {
+        if (block_) block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    void release();
+
+    static void recycle(Block* block);
+
+    Block* block_ = nullptr;
+};
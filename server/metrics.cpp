@@ -0,0 +1,167 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+array<atomic<int64_t>, static_cast<size_t>(Gauge::kCount)> Metrics::gauges_{};
+
+namespace {
+
+struct Info {
+    const char* name;
+    const char* help;
+};
+
+const Info kCounterInfo[] = {
+    {"rps_lines_received_total", "Lines received from clients."},
+    {"rps_moves_resolved_total", "Challenges resolved by /move."},
+    {"rps_challenge_timeouts_total", "Challenges resolved by timeout."},
+    {"rps_broadcast_messages_total", "Messages fanned out to a room."},
+    {"rps_broadcast_deliveries_total", "Recipients across all room broadcasts."},
+    {"rps_broadcast_bytes_total", "Bytes queued by room broadcasts (size times recipients)."},
+    {"rps_socket_bytes_written_total", "Bytes written to client connections."},
+    {"rps_sessions_opened_total", "Client connections accepted."},
+    {"rps_matches_formed_total", "Matches made by the /queue matchmaker."},
+    {"rps_lines_rate_limited_total", "Client lines dropped by per-session rate limits."},
+    {"rps_chat_shed_total", "Chat deliveries dropped under load or for slow readers."},
+    {"rps_chat_held_total", "Chat lines held back under load and sent in a per-tick batch."},
+    {"rps_connections_refused_total", "Connections refused by the connection cap or overload."},
+    {"rps_joins_refused_total", "Room joins refused while overloaded."},
+};
+static_assert(size(kCounterInfo) == static_cast<size_t>(Counter::kCount));
+
+struct HistogramInfo {
+    const char* name;
+    const char* help;
+    double scale;  // recorded units per exported unit
+};
+
+const HistogramInfo kHistogramInfo[] = {
+    {"rps_registry_lock_wait_seconds", "Time spent waiting for a player registry shard lock.", 1e9},
+    {"rps_registry_lock_hold_seconds", "Time a player registry shard lock was held.", 1e9},
+    {"rps_move_resolution_seconds", "Time to resolve a /move, locks included.", 1e9},
+    {"rps_broadcast_fanout_seconds", "Time to queue one room broadcast for every recipient.", 1e9},
+    {"rps_status_flush_seconds", "Time to build and queue one room's status delta.", 1e9},
+    {"rps_socket_write_seconds", "Time from handing a batch to the transport until it is written.", 1e9},
+    {"rps_timer_lag_seconds", "How late timer wheel callbacks fire after their deadline.", 1e9},
+    {"rps_queue_wait_seconds", "Time from /queue until the player was paired.", 1e9},
+    {"rps_matches_per_tick", "Matches one room formed in one matchmaking pass.", 1},
+};
+static_assert(size(kHistogramInfo) == static_cast<size_t>(Histogram::kCount));
+
+const Info kGaugeInfo[] = {
+    {"rps_active_sessions", "Client connections currently open."},
+    {"rps_worker_threads", "Threads running the io_context."},
+};
+static_assert(size(kGaugeInfo) == static_cast<size_t>(Gauge::kCount));
+
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+mutex blocks_mutex;
+
+void header(string& out, const Info& info, const char* type) {
+    out += "# HELP ";
+    out += info.name;
+    out += ' ';
+    out += info.help;
+    out += "\n# TYPE ";
+    out += info.name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void sample(string& out, const char* name, const char* suffix, const char* labels, double value) {
+    char line[256];
+    snprintf(line, sizeof(line), "%s%s%s %.9g\n", name, suffix, labels, value);
+    out += line;
+}
+
+}  // namespace
+
+// Owned here rather than by the threads, so they outlive them.
+vector<unique_ptr<Metrics::ThreadBlock>>& Metrics::blocks() {
+    static vector<unique_ptr<ThreadBlock>> all;
+    return all;
+}
+
+Metrics::ThreadBlock* Metrics::register_thread() {
+    lock_guard<mutex> lock(blocks_mutex);
+    blocks().push_back(make_unique<ThreadBlock>());
+    return blocks().back().get();
+}
+
+size_t Metrics::bucket_of(uint64_t ns) {
+    constexpr uint64_t kSub = 1u << kSubBucketBits;
+    if (ns < 2 * kSub) return static_cast<size_t>(ns);
+    if (ns >> kMaxExponent) ns = (uint64_t{1} << kMaxExponent) - 1;
+    int exponent = 63 - __builtin_clzll(ns);
+    int shift = exponent - kSubBucketBits;
+    return static_cast<size_t>(((shift + 1) << kSubBucketBits) + ((ns >> shift) - kSub));
+}
+
+uint64_t Metrics::bucket_value(size_t bucket) {
+    constexpr size_t kSub = size_t{1} << kSubBucketBits;
+    if (bucket < 2 * kSub) return bucket;
+    int shift = static_cast<int>(bucket >> kSubBucketBits) - 1;
+    uint64_t mantissa = kSub + (bucket & (kSub - 1));
+    return (mantissa << shift) + (uint64_t{1} << shift) / 2;
+}
+
+void Metrics::render_value(string& out, const char* name, const char* help, const char* type, double value) {
+    header(out, Info{name, help}, type);
+    sample(out, name, "", "", value);
+}
+
+void Metrics::render(string& out) {
+    if constexpr (!kMetricsEnabled) return;
+
+    array<uint64_t, static_cast<size_t>(Counter::kCount)> counters{};
+    vector<uint64_t> buckets(kBuckets);
+    {
+        lock_guard<mutex> lock(blocks_mutex);
+        for (const auto& block : blocks()) {
+            for (size_t i = 0; i < counters.size(); ++i) counters[i] += block->counters[i].load(memory_order_relaxed);
+        }
+        for (size_t i = 0; i < counters.size(); ++i) {
+            header(out, kCounterInfo[i], "counter");
+            sample(out, kCounterInfo[i].name, "", "", static_cast<double>(counters[i]));
+        }
+
+        for (size_t h = 0; h < static_cast<size_t>(Histogram::kCount); ++h) {
+            // Merge every thread's buckets, then walk them once for all quantiles.
+            fill(buckets.begin(), buckets.end(), 0);
+            uint64_t count = 0, sum = 0;
+            for (const auto& block : blocks()) {
+                const auto& hist = block->histograms[h];
+                for (size_t b = 0; b < kBuckets; ++b) buckets[b] += hist.buckets[b].load(memory_order_relaxed);
+                count += hist.count.load(memory_order_relaxed);
+                sum += hist.sum.load(memory_order_relaxed);
+            }
+            const HistogramInfo& hinfo = kHistogramInfo[h];
+            const Info info{hinfo.name, hinfo.help};
+            header(out, info, "summary");
+            uint64_t seen = 0;
+            size_t b = 0;
+            for (double q : kQuantiles) {
+                auto rank = static_cast<uint64_t>(q * count);
+                while (b < kBuckets && seen + buckets[b] <= rank) seen += buckets[b++];
+                char labels[32];
+                snprintf(labels, sizeof(labels), "{quantile=\"%g\"}", q);
+                double value = count ? bucket_value(min(b, kBuckets - 1)) / hinfo.scale : 0.0;
+                sample(out, info.name, "", labels, value);
+            }
+            sample(out, info.name, "_sum", "", sum / hinfo.scale);
+            sample(out, info.name, "_count", "", static_cast<double>(count));
+        }
+    }
+
+    for (size_t i = 0; i < gauges_.size(); ++i) {
+        header(out, kGaugeInfo[i], "gauge");
+        sample(out, kGaugeInfo[i].name, "", "", static_cast<double>(gauges_[i].load(memory_order_relaxed)));
+    }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hot-path counters and latency histograms. Every thread writes to its own
+// block with plain relaxed stores (no lock prefix, no shared cache lines) and
+// readers merge all blocks when rendering. Building without RPS_METRICS turns
+// every call below into nothing, clock reads included.
+#ifdef RPS_METRICS
+inline constexpr bool kMetricsEnabled = true;
+#else
+inline constexpr bool kMetricsEnabled = false;
+#endif
+
+enum class Counter : std::uint8_t {
+    LinesReceived,
+    MovesResolved,
+    ChallengeTimeouts,
+    BroadcastMessages,
+    BroadcastDeliveries,  // recipients across all broadcasts
+    BroadcastBytes,       // message size times recipients
+    SocketBytesWritten,
+    SessionsOpened,
+    MatchesFormed,
+    LinesRateLimited,    // dropped by a session's token buckets
+    ChatShed,            // chat deliveries dropped under load
+    ChatHeld,            // chat lines held under load and sent in a later batch
+    ConnectionsRefused,  // over the connection cap or overloaded
+    JoinsRefused,        // room changes refused while overloaded
+    kCount,
+};
+
+enum class Histogram : std::uint8_t {
+    RegistryLockWait,
+    RegistryLockHold,
+    MoveResolution,
+    BroadcastFanout,
+    StatusFlush,
+    SocketWrite,  // handing a batch to the transport until it is on the wire
+    TimerLag,     // how late timer wheel callbacks fire
+    QueueWait,    // /queue until paired
+    MatchesPerTick,  // a count (see record): matches one room formed in one pass
+    kCount,
+};
+
+// Rarely-changing values shared by all threads.
+enum class Gauge : std::uint8_t {
+    ActiveSessions,
+    WorkerThreads,
+    kCount,
+};
+
+class Metrics {
+public:
+    // HDR-style log-linear buckets over nanoseconds (or counts): exact below 32, then
+    // 16 buckets per power of two (at most ~6% error), capped at 2^40.
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kMaxExponent = 40;
+    static constexpr std::size_t kBuckets = (kMaxExponent - kSubBucketBits + 1) << kSubBucketBits;
+
+    static void add(Counter c, std::uint64_t n = 1) {
+        if constexpr (kMetricsEnabled) bump(local().counters[index(c)], n);
+    }
+
+    static void observe(Histogram h, std::chrono::nanoseconds d) {
+        record(h, static_cast<std::uint64_t>(d.count() < 0 ? 0 : d.count()));
+    }
+    // For histograms of counts rather than durations.
+    static void record(Histogram h, std::uint64_t value) {
+        if constexpr (kMetricsEnabled) {
+            auto& hist = local().histograms[index(h)];
+            bump(hist.buckets[bucket_of(value)], 1);
+            bump(hist.count, 1);
+            bump(hist.sum, value);
+        }
+    }
+
+    static void gauge_add(Gauge g, std::int64_t delta) {
+        if constexpr (kMetricsEnabled) gauges_[index(g)].fetch_add(delta, std::memory_order_relaxed);
+    }
+    static void gauge_set(Gauge g, std::int64_t value) {
+        if constexpr (kMetricsEnabled) gauges_[index(g)].store(value, std::memory_order_relaxed);
+    }
+
+    // Appends everything in the Prometheus text format. Histograms are
+    // rendered as summaries (p50/p90/p99/p999, sum, count) in seconds.
+    static void render(std::string& out);
+
+    // One metric outside this registry (values other modules already keep),
+    // with its HELP and TYPE lines.
+    static void render_value(std::string& out, const char* name, const char* help, const char* type,
+                             double value);
+
+    static std::size_t bucket_of(std::uint64_t ns);
+    // Midpoint of a bucket, for quantile estimates.
+    static std::uint64_t bucket_value(std::size_t bucket);
+
+private:
+    struct HistogramBlock {
+        std::array<std::atomic<std::uint64_t>, kBuckets> buckets{};
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> sum{0};
+    };
+    struct alignas(64) ThreadBlock {
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(Counter::kCount)> counters{};
+        std::array<HistogramBlock, static_cast<std::size_t>(Histogram::kCount)> histograms;
+    };
+
+    template <typename E>
+    static constexpr std::size_t index(E e) { return static_cast<std::size_t>(e); }
+
+    // Single writer per block, so a relaxed load + store is enough.
+    static void bump(std::atomic<std::uint64_t>& v, std::uint64_t n) {
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static ThreadBlock& local() {
+        thread_local ThreadBlock* block = register_thread();
+        return *block;
+    }
+    // Blocks are never freed, so counts from finished threads are kept.
+    static ThreadBlock* register_thread();
+    static std::vector<std::unique_ptr<ThreadBlock>>& blocks();
+
+    static std::array<std::atomic<std::int64_t>, static_cast<std::size_t>(Gauge::kCount)> gauges_;
+};
+
+// Records the lifetime of the scope into a histogram.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram h) : histogram_(h) {
+        if constexpr (kMetricsEnabled) start_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if constexpr (kMetricsEnabled) Metrics::observe(histogram_, std::chrono::steady_clock::now() - start_);
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// A std::mutex that reports how long callers waited for it and how long they
+// held it. Usable with unique_lock / lock_guard like the mutex it wraps.
+template <Histogram Wait, Histogram Hold>
+class TimedMutex {
+public:
+    void lock() {
+        if constexpr (kMetricsEnabled) {
+            auto start = std::chrono::steady_clock::now();
+            mutex_.lock();
+            acquired_ = std::chrono::steady_clock::now();
+            Metrics::observe(Wait, acquired_ - start);
+        } else {
+            mutex_.lock();
+        }
+    }
+    bool try_lock() {
+        if (!mutex_.try_lock()) return false;
+        if constexpr (kMetricsEnabled) acquired_ = std::chrono::steady_clock::now();
+        return true;
+    }
+    void unlock() {
+        if constexpr (kMetricsEnabled) {
+            auto held = std::chrono::steady_clock::now() - acquired_;
+            mutex_.unlock();
+            Metrics::observe(Hold, held);
+        } else {
+            mutex_.unlock();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::chrono::steady_clock::time_point acquired_;  // written only by the owner
+};
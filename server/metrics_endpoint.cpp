@@ -0,0 +1,74 @@
+#include "metrics_endpoint.hpp"
+
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+using boost::asio::ip::tcp;
+using namespace std;
+
+namespace {
+
+constexpr size_t kMaxRequest = 8192;
+
+struct Scrape : enable_shared_from_this<Scrape> {
+    Scrape(tcp::socket s, const MetricsEndpoint::Renderer& r) : socket(std::move(s)), request(kMaxRequest), render(r) {}
+
+    void start() {
+        boost::asio::async_read_until(socket, request, "\r\n\r\n",
+            [self = shared_from_this()](const boost::system::error_code& ec, size_t length) {
+                if (ec) return;
+                self->respond(string_view(static_cast<const char*>(self->request.data().data()), length));
+            });
+    }
+
+    void respond(string_view head) {
+        string_view request_line = head.substr(0, head.find("\r\n"));
+        string status = "200 OK", body;
+        if (request_line.substr(0, 4) != "GET ") {
+            status = "405 Method Not Allowed";
+        } else {
+            string_view path = request_line.substr(4, request_line.find(' ', 4) - 4);
+            if (path == "/metrics" || path == "/") body = render();
+            else status = "404 Not Found";
+        }
+        response = "HTTP/1.0 " + status + "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                   + to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        boost::asio::async_write(socket, boost::asio::buffer(response),
+            [self = shared_from_this()](const boost::system::error_code&, size_t) {
+                boost::system::error_code ignored;
+                self->socket.shutdown(tcp::socket::shutdown_both, ignored);
+            });
+    }
+
+    tcp::socket socket;
+    boost::asio::streambuf request;
+    MetricsEndpoint::Renderer render;
+    string response;
+};
+
+}  // namespace
+
+MetricsEndpoint::MetricsEndpoint(boost::asio::io_context& io_context, const tcp::endpoint& endpoint,
+                                 Renderer render)
+    : io_context_(io_context), acceptor_(io_context, endpoint), render_(std::move(render)) {}
+
+void MetricsEndpoint::start() { do_accept(); }
+
+void MetricsEndpoint::stop() {
+    boost::system::error_code ignored;
+    acceptor_.close(ignored);
+}
+
+void MetricsEndpoint::do_accept() {
+    acceptor_.async_accept(boost::asio::make_strand(io_context_),
+        [this](const boost::system::error_code& ec, tcp::socket socket) {
+            if (!ec) {
+                make_shared<Scrape>(std::move(socket), render_)->start();
+            } else if (ec != boost::asio::error::operation_aborted) {
+                cerr << "Metrics accept error: " << ec.message() << endl;
+            }
+            if (acceptor_.is_open()) do_accept();
+        });
+}
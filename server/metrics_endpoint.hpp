@@ -0,0 +1,26 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <functional>
+#include <string>
+
+// A minimal HTTP/1.0 responder for Prometheus scrapes. Every GET for
+// /metrics (or /) gets the text from `render`; the connection is closed after
+// each response. Meant for a loopback port, not for the open internet.
+class MetricsEndpoint {
+public:
+    using Renderer = std::function<std::string()>;
+
+    MetricsEndpoint(boost::asio::io_context& io_context, const boost::asio::ip::tcp::endpoint& endpoint,
+                    Renderer render);
+
+    void start();
+    void stop();
+
+private:
+    void do_accept();
+
+    boost::asio::io_context& io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    Renderer render_;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "rate_limiter.hpp"
+#include "rules.hpp"
+#include "session.hpp"
+#include "timer_wheel.hpp"
+
+class Room;
+
+enum class GameMode { NONE, DEATHMATCH, LAST_MAN_STANDING };
+
+// Everything below `session` is guarded by the lock of the registry shard the
+// player lives in (see PlayerRegistry). `name` only changes on /login, which
+// holds that lock and runs on the lobby strand.
+struct Player {
+    int id;
+    std::string name;
+    RateLimiter limiter;  // session strand only (see handle_line)
+    std::shared_ptr<Session> session;
+    int num_games_played = 0;
+    int games_won = 0;
+    bool in_match = false;
+    int challenged_by = -1;
+    char pending_choice = '\0';
+    bool challenge_responded = false;
+    int hp = INITIAL_HP;
+    int current_winstreak = 0;
+    int challenge_id = 0;
+    TimerWheel::TimerId challenge_timer = 0;
+    GameMode mode = GameMode::NONE;
+    GameMode queue_on_enter = GameMode::NONE;  // /queue for another mode: join its queue on arrival
+    bool persistent = false;  // logged in with /login; stats are saved under `name`
+    std::shared_ptr<Room> room;  // the room whose strand runs this player's commands
+
+    float win_ratio() const {
+        if (num_games_played == 0) return 0.0f;
+        return num_games_played > 0 ? static_cast<double>(games_won) / num_games_played : 0.0;
+    }
+};
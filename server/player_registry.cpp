@@ -0,0 +1,67 @@
+#include "player_registry.hpp"
+
+using namespace std;
+
+PlayerRegistry::PlayerRegistry(size_t num_shards) {
+    // Round up to a power of two so shard_of is a mask.
+    size_t n = 1;
+    while (n < num_shards) n <<= 1;
+    shards_ = vector<Shard>(n);
+}
+
+size_t PlayerRegistry::shard_of(int id) const {
+    // Mix the id so consecutive connections land on different shards.
+    uint32_t h = static_cast<uint32_t>(id) * 0x85EBCA6Bu;
+    h ^= h >> 16;
+    return h & (shards_.size() - 1);
+}
+
+unique_lock<PlayerRegistry::ShardMutex> PlayerRegistry::lock(int id) {
+    return unique_lock<ShardMutex>(shards_[shard_of(id)].mutex);
+}
+
+PlayerRegistry::PairLock PlayerRegistry::lock_pair(int a, int b) {
+    size_t sa = shard_of(a);
+    size_t sb = shard_of(b);
+    if (sa == sb) return PairLock(unique_lock<ShardMutex>(shards_[sa].mutex), {});
+    if (sa > sb) swap(sa, sb);
+    unique_lock<ShardMutex> first(shards_[sa].mutex);
+    unique_lock<ShardMutex> second(shards_[sb].mutex);
+    return PairLock(std::move(first), std::move(second));
+}
+
+shared_ptr<Player> PlayerRegistry::find_locked(int id) const {
+    auto* p = shards_[shard_of(id)].players.find(id);
+    return p ? *p : nullptr;
+}
+
+shared_ptr<Player> PlayerRegistry::find(int id) {
+    auto guard = lock(id);
+    return find_locked(id);
+}
+
+void PlayerRegistry::insert(const shared_ptr<Player>& player) {
+    auto guard = lock(player->id);
+    shards_[shard_of(player->id)].players.insert(player->id, player);
+}
+
+bool PlayerRegistry::erase(int id) {
+    auto guard = lock(id);
+    return shards_[shard_of(id)].players.erase(id);
+}
+
+void PlayerRegistry::clear() {
+    for (auto& shard : shards_) {
+        lock_guard<ShardMutex> guard(shard.mutex);
+        shard.players = FlatIntMap<shared_ptr<Player>>();
+    }
+}
+
+size_t PlayerRegistry::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        lock_guard<ShardMutex> guard(shard.mutex);
+        total += shard.players.size();
+    }
+    return total;
+}
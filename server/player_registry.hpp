@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "flat_int_map.hpp"
+#include "metrics.hpp"
+#include "player.hpp"
+
+// All connected players, split across ID-hashed shards. Each shard's mutex
+// guards its map and the mutable fields of the players stored in it, so work
+// on unrelated players proceeds in parallel.
+//
+// Locking protocol: a thread holds at most two shard locks at once, and only
+// through lock_pair(), which takes them in ascending shard order (one lock if
+// both players share a shard). Other locks (game state, status, timers,
+// session queues) may be taken while holding shard locks, never the reverse.
+class PlayerRegistry {
+public:
+    // Reports wait and hold times when metrics are compiled in.
+    using ShardMutex = TimedMutex<Histogram::RegistryLockWait, Histogram::RegistryLockHold>;
+
+    class PairLock {
+    public:
+        PairLock() = default;
+        PairLock(std::unique_lock<ShardMutex> first, std::unique_lock<ShardMutex> second)
+            : first_(std::move(first)), second_(std::move(second)) {}
+
+    private:
+        std::unique_lock<ShardMutex> first_;
+        std::unique_lock<ShardMutex> second_;
+    };
+
+    explicit PlayerRegistry(std::size_t num_shards = 64);
+
+    std::unique_lock<ShardMutex> lock(int id);
+    PairLock lock_pair(int a, int b);
+
+    // Caller must hold the lock of id's shard (via lock() or lock_pair()).
+    std::shared_ptr<Player> find_locked(int id) const;
+    // Takes the shard lock itself.
+    std::shared_ptr<Player> find(int id);
+
+    void insert(const std::shared_ptr<Player>& player);
+    bool erase(int id);
+    void clear();
+    std::size_t size() const;
+
+    // Visits every player, holding one shard lock at a time; players in
+    // different shards are not seen as one atomic snapshot.
+    template <typename F>
+    void for_each(F&& f) {
+        for (auto& shard : shards_) {
+            std::lock_guard<ShardMutex> guard(shard.mutex);
+            shard.players.for_each([&](int, const std::shared_ptr<Player>& p) { f(p); });
+        }
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable ShardMutex mutex;
+        FlatIntMap<std::shared_ptr<Player>> players;
+    };
+
+    std::size_t shard_of(int id) const;
+
+    std::vector<Shard> shards_;
+};
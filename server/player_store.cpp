@@ -0,0 +1,428 @@
+#include "player_store.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'R', 'P', 'S', 'S', 'N', 'A', 'P', '1'};
+constexpr char kLogMagic[8] = {'R', 'P', 'S', 'L', 'O', 'G', '0', '1'};
+constexpr uint32_t kVersion = 1;
+// save() wakes the writer early once this many records are queued.
+constexpr size_t kMaxBatch = 4096;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t generation;  // matches the header of the log that follows it
+    uint64_t count;
+    uint64_t index_buckets;  // a power of two
+};
+
+struct LogHeader {
+    char magic[8];
+    uint64_t generation;
+};
+
+uint32_t checksum(const void* data, size_t size) {
+    // FNV-1a; enough to spot a torn write.
+    uint32_t h = 2166136261u;
+    auto p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+string errno_text(const string& what) { return what + ": " + strerror(errno); }
+
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}  // namespace
+
+PlayerStore::PlayerStore(string dir, chrono::milliseconds flush_interval, size_t compact_after)
+    : dir_(std::move(dir)), flush_interval_(flush_interval), compact_after_(max<size_t>(compact_after, 1)) {}
+
+PlayerStore::~PlayerStore() {
+    stop();
+    if (log_fd_ >= 0) ::close(log_fd_);
+    unmap(snapshot_);
+}
+
+uint64_t PlayerStore::hash(string_view name) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : name) h = (h ^ c) * 1099511628211ull;
+    return h;
+}
+
+PlayerStore::Record PlayerStore::make_record(string_view name, const Stats& stats) {
+    Record record{};  // zero-filled, so checksums and snapshot bytes are deterministic
+    memcpy(record.name, name.data(), min(name.size(), kMaxNameLength));
+    record.games_played = stats.games_played;
+    record.games_won = stats.games_won;
+    record.hp = stats.hp;
+    record.winstreak = stats.winstreak;
+    return record;
+}
+
+PlayerStore::Stats PlayerStore::stats_of(const Record& record) {
+    return Stats{record.games_played, record.games_won, record.hp, record.winstreak};
+}
+
+const PlayerStore::Record* PlayerStore::find_in(const Snapshot& snapshot, string_view name) {
+    if (snapshot.count == 0) return nullptr;
+    for (uint64_t bucket = hash(name) & snapshot.index_mask;; bucket = (bucket + 1) & snapshot.index_mask) {
+        uint32_t slot = snapshot.index[bucket];
+        if (slot == 0 || slot > snapshot.count) return nullptr;
+        const Record& record = snapshot.records[slot - 1];
+        if (string_view(record.name, strnlen(record.name, sizeof(record.name))) == name) return &record;
+    }
+}
+
+bool PlayerStore::map_snapshot(const string& path, Snapshot& out, string& error) {
+    out = Snapshot{};
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return true;  // first run
+        error = errno_text(path);
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) < 0) {
+        error = errno_text(path);
+        ::close(fd);
+        return false;
+    }
+    const auto length = static_cast<size_t>(st.st_size);
+    if (length < sizeof(SnapshotHeader)) {
+        error = path + ": truncated header";
+        ::close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        error = errno_text(path);
+        return false;
+    }
+
+    const auto* header = static_cast<const SnapshotHeader*>(base);
+    const uint64_t buckets = header->index_buckets;
+    const bool valid = memcmp(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) == 0
+                       && header->version == kVersion && header->record_size == sizeof(Record)
+                       && header->count < UINT32_MAX && buckets != 0 && (buckets & (buckets - 1)) == 0
+                       && buckets > header->count
+                       && length == sizeof(SnapshotHeader) + header->count * sizeof(Record)
+                                        + buckets * sizeof(uint32_t);
+    if (!valid) {
+        munmap(base, length);
+        error = path + ": not a version " + to_string(kVersion) + " snapshot, or damaged";
+        return false;
+    }
+    const char* bytes = static_cast<const char*>(base);
+    out.base = base;
+    out.length = length;
+    out.count = header->count;
+    out.generation = header->generation;
+    out.index_mask = buckets - 1;
+    out.records = reinterpret_cast<const Record*>(bytes + sizeof(SnapshotHeader));
+    out.index = reinterpret_cast<const uint32_t*>(bytes + sizeof(SnapshotHeader) + out.count * sizeof(Record));
+    return true;
+}
+
+void PlayerStore::unmap(Snapshot& snapshot) {
+    if (snapshot.base) munmap(snapshot.base, snapshot.length);
+    snapshot = Snapshot{};
+}
+
+bool PlayerStore::reset_log(uint64_t generation) {
+    LogHeader header{};
+    memcpy(header.magic, kLogMagic, sizeof(kLogMagic));
+    header.generation = generation;
+    return ftruncate(log_fd_, 0) == 0 && write_all(log_fd_, reinterpret_cast<const char*>(&header), sizeof(header))
+           && fdatasync(log_fd_) == 0;
+}
+
+bool PlayerStore::replay_log(string& error) {
+    const string path = dir_ + "/players.log";
+    log_fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd_ < 0) {
+        error = errno_text(path);
+        return false;
+    }
+    vector<char> data;
+    char chunk[1 << 16];
+    for (;;) {
+        ssize_t n = ::read(log_fd_, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            error = errno_text(path);
+            return false;
+        }
+        if (n == 0) break;
+        data.insert(data.end(), chunk, chunk + n);
+    }
+
+    LogHeader header{};
+    if (data.size() >= sizeof(header)) memcpy(&header, data.data(), sizeof(header));
+    if (data.size() < sizeof(header) || header.generation < snapshot_.generation) {
+        // Empty, or already folded into the snapshot by a compaction that
+        // stopped before it could reset the log.
+        if (data.size() >= sizeof(header) && memcmp(header.magic, kLogMagic, sizeof(kLogMagic)) != 0) {
+            error = path + ": not a player log";
+            return false;
+        }
+        if (!reset_log(snapshot_.generation)) {
+            error = errno_text(path);
+            return false;
+        }
+        return true;
+    }
+    if (memcmp(header.magic, kLogMagic, sizeof(kLogMagic)) != 0) {
+        error = path + ": not a player log";
+        return false;
+    }
+    if (header.generation > snapshot_.generation) {
+        error = path + ": newer than the snapshot; was players.snap replaced?";
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    uint64_t replayed = 0;
+    for (; offset + sizeof(LogEntry) <= data.size(); offset += sizeof(LogEntry)) {
+        LogEntry entry;
+        memcpy(&entry, data.data() + offset, sizeof(entry));
+        if (entry.checksum != checksum(&entry.record, sizeof(entry.record))) break;
+        entry.record.name[kMaxNameLength] = '\0';
+        overlay_[entry.record.name] = entry.record;
+        replayed++;
+    }
+    if (offset != data.size()) {
+        cerr << path << ": dropping " << data.size() - offset << " bytes of torn or damaged tail" << endl;
+        if (ftruncate(log_fd_, static_cast<off_t>(offset)) < 0) {
+            error = errno_text(path);
+            return false;
+        }
+    }
+    counters_.log_records = replayed;
+    return true;
+}
+
+bool PlayerStore::open(string& error) {
+    if (mkdir(dir_.c_str(), 0755) < 0 && errno != EEXIST) {
+        error = errno_text(dir_);
+        return false;
+    }
+    if (!map_snapshot(dir_ + "/players.snap", snapshot_, error)) return false;
+    counters_.snapshot_records = snapshot_.count;
+    return replay_log(error);
+}
+
+void PlayerStore::start() {
+    writer_ = thread([this] { run(); });
+}
+
+void PlayerStore::stop() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (stopping_ || !writer_.joinable()) return;
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+}
+
+bool PlayerStore::load(string_view name, Stats& out) {
+    // Held throughout, so the writer can't move a record from pending_ into
+    // overlay_ between the two lookups.
+    lock_guard<mutex> index(index_mutex_);
+    {
+        lock_guard<mutex> lock(mutex_);
+        for (auto it = pending_.rbegin(); it != pending_.rend(); ++it) {
+            if (it->name == name) {
+                out = stats_of(*it);
+                return true;
+            }
+        }
+    }
+    const string key(name);
+    for (const auto* map : {&overlay_, &compacting_}) {
+        auto it = map->find(key);
+        if (it != map->end()) {
+            out = stats_of(it->second);
+            return true;
+        }
+    }
+    if (const Record* record = find_in(snapshot_, name)) {
+        out = stats_of(*record);
+        return true;
+    }
+    return false;
+}
+
+void PlayerStore::save(string_view name, const Stats& stats) {
+    Record record = make_record(name, stats);
+    bool wake;
+    {
+        lock_guard<mutex> lock(mutex_);
+        pending_.push_back(record);
+        wake = pending_.size() == kMaxBatch;
+    }
+    if (wake) wake_.notify_one();
+}
+
+PlayerStore::Counters PlayerStore::counters() {
+    lock_guard<mutex> lock(mutex_);
+    return counters_;
+}
+
+void PlayerStore::run() {
+    vector<Record> batch;
+    for (;;) {
+        bool stop;
+        {
+            unique_lock<mutex> lock(mutex_);
+            wake_.wait_for(lock, flush_interval_, [this] { return stopping_ || pending_.size() >= kMaxBatch; });
+            stop = stopping_;
+        }
+        bool compact_now;
+        {
+            lock_guard<mutex> index(index_mutex_);
+            {
+                // save() only ever waits for this swap.
+                lock_guard<mutex> lock(mutex_);
+                batch.swap(pending_);
+                compact_now = counters_.log_records + batch.size() >= compact_after_
+                              || (stop && counters_.log_records + batch.size() > 0);
+            }
+            for (const auto& record : batch) overlay_[record.name] = record;
+        }
+
+        if (!batch.empty()) append(batch);
+        batch.clear();
+        if (compact_now) compact();
+
+        lock_guard<mutex> lock(mutex_);
+        if (stop && pending_.empty()) return;
+    }
+}
+
+void PlayerStore::append(const vector<Record>& batch) {
+    vector<char> buffer(batch.size() * sizeof(LogEntry));
+    char* out = buffer.data();
+    for (const auto& record : batch) {
+        LogEntry entry{record, checksum(&record, sizeof(record)), 0};
+        memcpy(out, &entry, sizeof(entry));
+        out += sizeof(entry);
+    }
+    // The records are already in overlay_, so on failure they still make the
+    // next snapshot.
+    if (!write_all(log_fd_, buffer.data(), buffer.size()) || fdatasync(log_fd_) < 0) {
+        cerr << errno_text(dir_ + "/players.log") << endl;
+    }
+    lock_guard<mutex> lock(mutex_);
+    counters_.batches_written++;
+    counters_.records_written += batch.size();
+    counters_.log_records += batch.size();
+}
+
+void PlayerStore::compact() {
+    {
+        lock_guard<mutex> index(index_mutex_);
+        compacting_.swap(overlay_);
+    }
+    // snapshot_ is only ever replaced by this thread, so it can be read here
+    // without the lock.
+    vector<Record> records;
+    records.reserve(snapshot_.count + compacting_.size());
+    string name;
+    for (uint64_t i = 0; i < snapshot_.count; ++i) {
+        const Record& record = snapshot_.records[i];
+        name.assign(record.name, strnlen(record.name, sizeof(record.name)));
+        if (!compacting_.count(name)) records.push_back(record);
+    }
+    for (const auto& [key, record] : compacting_) records.push_back(record);
+
+    uint64_t buckets = 16;
+    while (buckets < 2 * records.size()) buckets <<= 1;
+    vector<uint32_t> index(buckets, 0);
+    for (size_t i = 0; i < records.size(); ++i) {
+        uint64_t bucket = hash(records[i].name) & (buckets - 1);
+        while (index[bucket] != 0) bucket = (bucket + 1) & (buckets - 1);
+        index[bucket] = static_cast<uint32_t>(i + 1);
+    }
+
+    SnapshotHeader header{};
+    memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.version = kVersion;
+    header.record_size = sizeof(Record);
+    header.generation = snapshot_.generation + 1;
+    header.count = records.size();
+    header.index_buckets = buckets;
+
+    const string path = dir_ + "/players.snap";
+    const string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 && write_all(fd, reinterpret_cast<const char*>(&header), sizeof(header))
+              && write_all(fd, reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record))
+              && write_all(fd, reinterpret_cast<const char*>(index.data()), index.size() * sizeof(uint32_t))
+              && fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+    ok = ok && ::rename(tmp.c_str(), path.c_str()) == 0;
+    if (ok) {
+        int dir_fd = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            ::close(dir_fd);
+        }
+    }
+
+    Snapshot fresh;
+    string error;
+    if (!ok || !map_snapshot(path, fresh, error)) {
+        // The log still holds everything; keep serving from memory and retry
+        // at the next compaction. Anything saved meanwhile is newer.
+        cerr << (error.empty() ? errno_text(tmp) : error) << endl;
+        lock_guard<mutex> index(index_mutex_);
+        for (auto& [key, record] : compacting_) overlay_.try_emplace(key, record);
+        compacting_.clear();
+        return;
+    }
+    // A crash before this reset leaves an older-generation log, which open()
+    // recognizes as already folded in.
+    if (!reset_log(header.generation)) cerr << errno_text(dir_ + "/players.log") << endl;
+
+    Snapshot old;
+    {
+        lock_guard<mutex> index(index_mutex_);
+        old = snapshot_;
+        snapshot_ = fresh;
+        compacting_.clear();
+    }
+    {
+        lock_guard<mutex> lock(mutex_);
+        counters_.snapshot_records = fresh.count;
+        counters_.log_records = 0;
+        counters_.compactions++;
+    }
+    unmap(old);
+}
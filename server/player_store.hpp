@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Stats of named players (see /login), kept across restarts in a directory
+// holding two files:
+//
+//   players.snap  fixed 48-byte records plus an open-addressing index over
+//                 their names, mmapped read-only at startup and looked up in
+//                 place, so opening it costs nothing per player;
+//   players.log   every save since that snapshot as a checksummed fixed
+//                 record, replayed into memory at startup.
+//
+// save() only queues the record; a background thread appends queued records
+// in batches (one write and one fdatasync per batch) and folds the log into a
+// fresh snapshot once it grows past `compact_after` records and on stop().
+// A torn tail from a crash fails its checksum and is cut off.
+class PlayerStore {
+public:
+    static constexpr std::size_t kMaxNameLength = 31;
+
+    struct Stats {
+        int games_played = 0;
+        int games_won = 0;
+        int hp = 0;
+        int winstreak = 0;
+    };
+
+    struct Counters {
+        std::uint64_t snapshot_records = 0;
+        std::uint64_t log_records = 0;  // since the last snapshot
+        std::uint64_t batches_written = 0;
+        std::uint64_t records_written = 0;
+        std::uint64_t compactions = 0;
+    };
+
+    explicit PlayerStore(std::string dir, std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100),
+                         std::size_t compact_after = 1 << 16);
+    ~PlayerStore();
+
+    // Maps the snapshot and replays the log. On failure, leaves the files
+    // untouched and says why in `error`.
+    bool open(std::string& error);
+    void start();
+    // Writes everything still queued, compacts and joins the writer.
+    void stop();
+
+    // 1-31 letters, digits, '_' or '-'. Inline so the parser can use it alone.
+    static bool valid_name(std::string_view name) {
+        if (name.empty() || name.size() > kMaxNameLength) return false;
+        for (char c : name) {
+            bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+            if (!ok) return false;
+        }
+        return true;
+    }
+    // "Player<digits>": what every session is called until /login (see
+    // handle_connect). Never valid for /login, so a guest and a named player
+    // can't end up with the same name.
+    static constexpr std::string_view kGuestPrefix = "Player";
+    static bool guest_name(std::string_view name) {
+        if (name.size() <= kGuestPrefix.size() || name.substr(0, kGuestPrefix.size()) != kGuestPrefix) return false;
+        for (char c : name.substr(kGuestPrefix.size())) {
+            if (c < '0' || c > '9') return false;
+        }
+        return true;
+    }
+
+    // Safe from any thread. Sees saves that are still queued.
+    bool load(std::string_view name, Stats& out);
+    // Safe from any thread; never touches the disk.
+    void save(std::string_view name, const Stats& stats);
+
+    Counters counters();
+
+private:
+    struct Record {
+        char name[kMaxNameLength + 1];
+        std::int32_t games_played;
+        std::int32_t games_won;
+        std::int32_t hp;
+        std::int32_t winstreak;
+    };
+    static_assert(sizeof(Record) == 48);
+
+    struct LogEntry {
+        Record record;
+        std::uint32_t checksum;
+        std::uint32_t reserved;
+    };
+
+    struct Snapshot {
+        const Record* records = nullptr;
+        const std::uint32_t* index = nullptr;  // slot + 1 per bucket, 0 if empty
+        std::uint64_t count = 0;
+        std::uint64_t index_mask = 0;
+        std::uint64_t generation = 0;
+        void* base = nullptr;
+        std::size_t length = 0;
+    };
+
+    static std::uint64_t hash(std::string_view name);
+    static Record make_record(std::string_view name, const Stats& stats);
+    static Stats stats_of(const Record& record);
+    static const Record* find_in(const Snapshot& snapshot, std::string_view name);
+
+    bool map_snapshot(const std::string& path, Snapshot& out, std::string& error);
+    static void unmap(Snapshot& snapshot);
+    bool replay_log(std::string& error);
+    bool reset_log(std::uint64_t generation);
+
+    void run();
+    void append(const std::vector<Record>& batch);
+    void compact();
+
+    const std::string dir_;
+    const std::chrono::milliseconds flush_interval_;
+    const std::size_t compact_after_;
+
+    // Guards what save() touches, so a /move never waits behind the writer
+    // updating the in-memory index.
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Record> pending_;  // queued by save()
+    Counters counters_;
+    bool stopping_ = false;
+
+    // Guards the index below. Taken before mutex_ when both are needed.
+    std::mutex index_mutex_;
+    std::unordered_map<std::string, Record> overlay_;     // saved since the snapshot
+    std::unordered_map<std::string, Record> compacting_;  // being folded into the next snapshot
+    Snapshot snapshot_;
+
+    // Writer thread only, apart from open().
+    int log_fd_ = -1;
+    std::thread writer_;
+};
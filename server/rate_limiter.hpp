@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "command_parser.hpp"
+
+// What a command is limited as. Game commands get the most headroom, so a
+// client flooding chat or room changes runs dry long before its /move does.
+enum class CommandClass : std::uint8_t { Chat, Game, Room, Query, kCount };
+
+inline CommandClass command_class(CommandType type) {
+    switch (type) {
+        case CommandType::Chat:
+            return CommandClass::Chat;
+        case CommandType::Challenge:
+        case CommandType::Move:
+            return CommandClass::Game;
+        case CommandType::Mode:
+        case CommandType::RoomCreate:
+        case CommandType::RoomJoin:
+        case CommandType::RoomLeave:
+        case CommandType::Queue:
+        case CommandType::Login:
+            return CommandClass::Room;
+        default:
+            return CommandClass::Query;
+    }
+}
+
+struct Rate {
+    double per_second;  // 0 means unlimited
+    double burst;
+};
+
+struct RateLimits {
+    Rate lines{50, 100};  // every line from one session
+    // Indexed by CommandClass.
+    std::array<Rate, static_cast<std::size_t>(CommandClass::kCount)> classes{{
+        {5, 10},   // Chat
+        {20, 40},  // Game
+        {2, 5},    // Room
+        {5, 10},   // Query
+    }};
+};
+
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Refills for the time since the last call, then takes one token if there is one.
+    bool take(const Rate& rate, Clock::time_point now) {
+        if (rate.per_second <= 0) return true;
+        if (!primed_) {
+            tokens_ = rate.burst;
+            primed_ = true;
+        } else {
+            tokens_ = std::min(rate.burst, tokens_ + std::chrono::duration<double>(now - last_).count() * rate.per_second);
+        }
+        last_ = now;
+        if (tokens_ < 1) return false;
+        tokens_ -= 1;
+        return true;
+    }
+    // Gives back the token a successful take() used.
+    void refund(const Rate& rate) {
+        if (rate.per_second > 0) tokens_ = std::min(rate.burst, tokens_ + 1);
+    }
+
+private:
+    double tokens_ = 0;
+    Clock::time_point last_{};
+    bool primed_ = false;
+};
+
+// One session's buckets: one for all of its lines and one per command class.
+// Not thread-safe; only used from the session's strand (see handle_line in
+// main.cpp).
+class RateLimiter {
+public:
+    // Applies to every session; call before the server starts accepting.
+    static void set_limits(const RateLimits& limits) { limits_ = limits; }
+
+    // False if the line should be dropped.
+    bool allow(CommandClass c, TokenBucket::Clock::time_point now = TokenBucket::Clock::now()) {
+        const auto i = static_cast<std::size_t>(c);
+        bool ok = classes_[i].take(limits_.classes[i], now);
+        // The class is checked first so a chat flood can't spend the line
+        // budget /move needs; a line refused overall keeps its class token.
+        if (ok && !lines_.take(limits_.lines, now)) {
+            classes_[i].refund(limits_.classes[i]);
+            ok = false;
+        }
+        if (ok) warned_ = false;
+        return ok;
+    }
+    // True for the first refusal in a row, so the client hears about it once
+    // rather than once per dropped line.
+    bool take_warning() { return !std::exchange(warned_, true); }
+
+private:
+    static inline RateLimits limits_;
+
+    TokenBucket lines_;
+    std::array<TokenBucket, static_cast<std::size_t>(CommandClass::kCount)> classes_;
+    bool warned_ = false;
+};
@@ -0,0 +1,100 @@
+#include "room.hpp"
+
+#include "metrics.hpp"
+
+using namespace std;
+
+const char* mode_name(GameMode mode) {
+    switch (mode) {
+        case GameMode::DEATHMATCH: return "deathmatch";
+        case GameMode::LAST_MAN_STANDING: return "lms";
+        default: return "lobby";
+    }
+}
+
+Room::Room(boost::asio::io_context& io_context, int id, string name, GameMode mode, RoomRules rules)
+    : id_(id), name_(std::move(name)), mode_(mode), rules_(rules), strand_(boost::asio::make_strand(io_context)) {}
+
+bool Room::open() const {
+    if (mode_ != GameMode::LAST_MAN_STANDING) return true;
+    return !started() && member_count() < static_cast<size_t>(rules_.lms_players);
+}
+
+void Room::add_member(const shared_ptr<Player>& player) {
+    if (members_.insert(player->id, player)) member_count_.fetch_add(1, memory_order_relaxed);
+}
+
+void Room::remove_member(int player_id) {
+    if (members_.erase(player_id)) member_count_.fetch_sub(1, memory_order_relaxed);
+}
+
+vector<shared_ptr<Session>> Room::member_sessions(const shared_ptr<Session>& except) const {
+    vector<shared_ptr<Session>> out;
+    out.reserve(members_.size());
+    members_.for_each([&](int, const shared_ptr<Player>& p) {
+        if (p->session && p->session != except) out.push_back(p->session);
+    });
+    return out;
+}
+
+void Room::broadcast(const string& message, const shared_ptr<Session>& except, MessageKind kind) {
+    ScopedTimer timer(Histogram::BroadcastFanout);
+    auto buffer = MessageBuffer::make(message);
+    uint64_t recipients = 0;
+    members_.for_each([&](int, const shared_ptr<Player>& p) {
+        if (p->session && p->session != except) {
+            p->session->deliver(buffer, kind);
+            recipients++;
+        }
+    });
+    Metrics::add(Counter::BroadcastMessages);
+    Metrics::add(Counter::BroadcastDeliveries, recipients);
+    Metrics::add(Counter::BroadcastBytes, recipients * buffer.size());
+}
+
+RoomManager::RoomManager(boost::asio::io_context& io_context)
+    : io_context_(io_context),
+      lobby_(make_shared<Room>(io_context, 0, "lobby", GameMode::NONE)) {
+    rooms_.emplace(0, lobby_);
+}
+
+shared_ptr<Room> RoomManager::create(GameMode mode, string name, RoomRules rules) {
+    lock_guard<mutex> lock(mutex_);
+    int id = next_id_++;
+    if (name.empty()) name = string(mode_name(mode)) + "-" + to_string(id);
+    auto room = make_shared<Room>(io_context_, id, std::move(name), mode, rules);
+    rooms_.emplace(id, room);
+    return room;
+}
+
+shared_ptr<Room> RoomManager::find(int id) const {
+    lock_guard<mutex> lock(mutex_);
+    auto it = rooms_.find(id);
+    return it == rooms_.end() ? nullptr : it->second;
+}
+
+shared_ptr<Room> RoomManager::find_open(GameMode mode) const {
+    lock_guard<mutex> lock(mutex_);
+    shared_ptr<Room> best;
+    for (auto& [id, room] : rooms_) {
+        if (room->mode() != mode || !room->open()) continue;
+        if (!best || room->member_count() > best->member_count()) best = room;
+    }
+    return best;
+}
+
+bool RoomManager::remove_if_empty(Room& room) {
+    if (&room == lobby_.get() || room.member_count() != 0) return false;
+    lock_guard<mutex> lock(mutex_);
+    rooms_.erase(room.id());
+    room.retired = true;
+    return true;
+}
+
+vector<shared_ptr<Room>> RoomManager::list() const {
+    lock_guard<mutex> lock(mutex_);
+    vector<shared_ptr<Room>> out;
+    out.reserve(rooms_.size());
+    for (auto& [id, room] : rooms_) out.push_back(room);
+    return out;
+}
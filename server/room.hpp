@@ -0,0 +1,118 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "flat_int_map.hpp"
+#include "matchmaker.hpp"
+#include "player.hpp"
+
+// Per-room game rules, fixed when the room is created.
+struct RoomRules {
+    int initial_hp = INITIAL_HP;
+    int lms_players = LMS_NUM_PLAYERS;
+};
+
+const char* mode_name(GameMode mode);
+
+// One independent game instance: its own members, mode, rules and broadcast
+// scope. Everything marked "strand only" is touched exclusively from the
+// room's strand, so a room needs no lock of its own and separate rooms run in
+// parallel on the shared thread pool.
+class Room {
+public:
+    using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+
+    Room(boost::asio::io_context& io_context, int id, std::string name, GameMode mode, RoomRules rules = {});
+
+    int id() const { return id_; }
+    const std::string& name() const { return name_; }
+    GameMode mode() const { return mode_; }
+    const RoomRules& rules() const { return rules_; }
+    Strand& strand() { return strand_; }
+
+    // Readable from any thread (for /room list and auto-join); written on the strand.
+    std::size_t member_count() const { return member_count_.load(std::memory_order_relaxed); }
+    bool started() const { return started_.load(std::memory_order_relaxed); }
+
+    // True if a new player may join right now (LMS rooms close once the game
+    // starts or the seats are taken).
+    bool open() const;
+
+    // --- strand only ---
+    void add_member(const std::shared_ptr<Player>& player);
+    void remove_member(int player_id);
+    const FlatIntMap<std::shared_ptr<Player>>& members() const { return members_; }
+    void set_started(bool started) { started_.store(started, std::memory_order_relaxed); }
+
+    // Sends to every member except `except`. The message is serialized once.
+    void broadcast(const std::string& message, const std::shared_ptr<Session>& except = nullptr,
+                   MessageKind kind = MessageKind::Normal);
+    std::vector<std::shared_ptr<Session>> member_sessions(const std::shared_ptr<Session>& except = nullptr) const;
+
+    // Player-status deltas for this room (see flush_player_status in main.cpp).
+    std::unordered_set<int> dirty_players;
+    std::vector<std::string> departed_players;
+    std::uint64_t status_version = 0;
+    // Set on the strand when dirty_players gains entries, so the flush timer
+    // only visits rooms that have something to send.
+    std::atomic<bool> status_pending{false};
+
+    // Chat lines held back while the server is overloaded, sent as one message
+    // on a later status tick (see flush_room_chat in main.cpp). Strand only,
+    // apart from chat_pending, which the tick reads like status_pending.
+    struct HeldChat {
+        int sender;
+        std::string line;
+    };
+    std::vector<HeldChat> held_chat;
+    std::size_t held_chat_bytes = 0;
+    std::atomic<bool> chat_pending{false};
+
+    // Players waiting for /queue pairing; drained by form_matches in main.cpp
+    // on every matchmaking tick.
+    MatchQueue match_queue;
+
+    // Set on the strand once the manager has dropped this room; late joiners
+    // are turned away.
+    bool retired = false;
+
+private:
+    const int id_;
+    const std::string name_;
+    const GameMode mode_;
+    const RoomRules rules_;
+    Strand strand_;
+    FlatIntMap<std::shared_ptr<Player>> members_;
+    std::atomic<std::size_t> member_count_{0};
+    std::atomic<bool> started_{false};
+};
+
+// Owns every room. The lobby (room 0) always exists; other rooms are removed
+// once their last member leaves.
+class RoomManager {
+public:
+    explicit RoomManager(boost::asio::io_context& io_context);
+
+    std::shared_ptr<Room> lobby() const { return lobby_; }
+    std::shared_ptr<Room> create(GameMode mode, std::string name, RoomRules rules = {});
+    std::shared_ptr<Room> find(int id) const;
+    // An open room of this mode, preferring the fullest so LMS games fill up.
+    std::shared_ptr<Room> find_open(GameMode mode) const;
+    // Strand only (of the room being removed). Returns true if it was removed.
+    bool remove_if_empty(Room& room);
+    std::vector<std::shared_ptr<Room>> list() const;
+
+private:
+    boost::asio::io_context& io_context_;
+    mutable std::mutex mutex_;
+    std::map<int, std::shared_ptr<Room>> rooms_;
+    std::shared_ptr<Room> lobby_;
+    int next_id_ = 1;
+};
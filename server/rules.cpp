@@ -0,0 +1,82 @@
+#include "rules.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+int move_index(char move) {
+    switch (move) {
+        case 'R': return 0;
+        case 'P': return 1;
+        case 'S': return 2;
+        default: return -1;
+    }
+}
+
+char move_char(int index) { return "RPS"[index]; }
+
+Outcome resolve(char first, char second) {
+    // (first - second) mod 3: 0 is a draw, 1 means first beats second.
+    int d = move_index(first) - move_index(second) + 3;
+    return static_cast<Outcome>(d >= 3 ? d - 3 : d);
+}
+
+void resolve_batch(const uint8_t* first, const uint8_t* second, Outcome* out, size_t n) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i two = _mm_set1_epi8(2);
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i));
+        __m128i d = _mm_sub_epi8(_mm_add_epi8(a, three), b);  // 1..5
+        d = _mm_sub_epi8(d, _mm_and_si128(_mm_cmpgt_epi8(d, two), three));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), d);
+    }
+#endif
+    for (; i < n; ++i) {
+        int d = first[i] + 3 - second[i];
+        out[i] = static_cast<Outcome>(d >= 3 ? d - 3 : d);
+    }
+}
+
+ResultEffects apply_result(bool lms, const RuleSet& rules, Outcome outcome, Standing& first, Standing& second) {
+    ResultEffects effects;
+    first.games_played++;
+    second.games_played++;
+    if (outcome == Outcome::Draw) {
+        if (lms) first.winstreak = second.winstreak = 0;
+        return effects;
+    }
+    Standing& winner = outcome == Outcome::FirstWins ? first : second;
+    Standing& loser = outcome == Outcome::FirstWins ? second : first;
+    winner.games_won++;
+    if (!lms) return effects;
+
+    loser.hp--;
+    loser.winstreak = 0;
+    winner.winstreak++;
+    if (winner.winstreak == rules.spree_length && winner.hp > 0) {
+        winner.hp += rules.spree_heal;
+        winner.winstreak = 0;
+        effects.spree = true;
+    }
+    effects.first_died = first.hp <= 0;
+    effects.second_died = second.hp <= 0;
+    return effects;
+}
+
+void PlayerTable::assign(size_t n, const RuleSet& rules) {
+    hp.assign(n, rules.initial_hp);
+    winstreak.assign(n, 0);
+    games_played.assign(n, 0);
+    games_won.assign(n, 0);
+}
+
+int PlayerTable::alive(size_t begin, size_t end) const {
+    int count = 0;
+    for (size_t i = begin; i < end; ++i) count += hp[i] > 0;
+    return count;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The game's rules with no I/O, locks or sessions: who wins a throw, what a
+// result does to both players in each mode, and when an LMS game is over. The
+// server applies them to Player fields (see main.cpp) and tournament_sim to
+// PlayerTable rows, so a rule change reaches both at once.
+
+const int LMS_NUM_PLAYERS = 3;
+const int INITIAL_HP = 5;
+
+enum class Outcome : std::uint8_t { Draw = 0, FirstWins = 1, SecondWins = 2 };
+
+// 0, 1, 2 for 'R', 'P', 'S'; -1 otherwise. Each move beats the one before it
+// (mod 3), which is what resolve_batch relies on.
+int move_index(char move);
+char move_char(int index);
+
+Outcome resolve(char first, char second);
+// The same for n throws given as move indices, 16 at a time with SSE2.
+void resolve_batch(const std::uint8_t* first, const std::uint8_t* second, Outcome* out, std::size_t n);
+
+struct RuleSet {
+    int initial_hp = INITIAL_HP;
+    int spree_length = 3;  // LMS wins in a row that earn a heal
+    int spree_heal = 1;
+};
+
+// The per-player numbers a result changes.
+struct Standing {
+    int hp = INITIAL_HP;
+    int winstreak = 0;
+    int games_played = 0;
+    int games_won = 0;
+};
+
+struct ResultEffects {
+    bool spree = false;  // the winner's streak just healed them
+    bool first_died = false;
+    bool second_died = false;
+};
+
+// Both sides play a game and the winner wins it. In LMS the loser also loses
+// 1 HP and their streak, a draw resets both streaks, and a winner whose
+// streak reaches spree_length is healed and starts a new streak.
+ResultEffects apply_result(bool lms, const RuleSet& rules, Outcome outcome, Standing& first, Standing& second);
+
+// An LMS game ends when exactly one player is left alive.
+inline bool lms_game_over(int alive) { return alive == 1; }
+
+// Standings of many players as parallel arrays, for code that sweeps over
+// thousands of them at once.
+struct PlayerTable {
+    std::vector<std::int32_t> hp;
+    std::vector<std::int32_t> winstreak;
+    std::vector<std::int32_t> games_played;
+    std::vector<std::int32_t> games_won;
+
+    std::size_t size() const { return hp.size(); }
+    void assign(std::size_t n, const RuleSet& rules);
+    Standing get(std::size_t i) const { return Standing{hp[i], winstreak[i], games_played[i], games_won[i]}; }
+    void set(std::size_t i, const Standing& s) {
+        hp[i] = s.hp;
+        winstreak[i] = s.winstreak;
+        games_played[i] = s.games_played;
+        games_won[i] = s.games_won;
+    }
+    // Players in [begin, end) with HP left.
+    int alive(std::size_t begin, std::size_t end) const;
+};
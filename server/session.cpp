@@ -0,0 +1,218 @@
+#include "session.hpp"
+
+#include <iostream>
+#include <utility>
+
+#include "metrics.hpp"
+
+using boost::asio::ip::tcp;
+using namespace std;
+
+OutboundLimits Session::limits_;
+AdmissionLimits Session::admission_;
+atomic<size_t> Session::active_{0};
+atomic<size_t> Session::total_queued_bytes_{0};
+atomic<uint64_t> Session::dropped_status_{0};
+atomic<uint64_t> Session::slow_disconnects_{0};
+
+Session::Session(boost::asio::any_io_executor strand, int id) : strand_(std::move(strand)), id_(id) {
+    Metrics::add(Counter::SessionsOpened);
+    Metrics::gauge_add(Gauge::ActiveSessions, 1);
+    active_.fetch_add(1, memory_order_relaxed);
+}
+
+void Session::add_queued(size_t bytes) {
+    queued_bytes_ += bytes;
+    total_queued_bytes_.fetch_add(bytes, memory_order_relaxed);
+}
+
+void Session::remove_queued(size_t bytes) {
+    queued_bytes_ -= bytes;
+    total_queued_bytes_.fetch_sub(bytes, memory_order_relaxed);
+}
+
+void Session::start(LineHandler on_line, CloseHandler on_close) {
+    on_line_ = std::move(on_line);
+    on_close_ = std::move(on_close);
+    boost::asio::dispatch(strand_, [self = shared_from_this()] {
+        self->start_transport();
+    });
+}
+
+void Session::deliver(MessageBuffer message, MessageKind kind) {
+    // Under overload chat goes first, so match traffic keeps its share.
+    if (kind == MessageKind::Chat && overloaded()) {
+        Metrics::add(Counter::ChatShed);
+        return;
+    }
+    bool kick = false;
+    {
+        lock_guard<mutex> lock(queue_mutex_);
+        if (stopped_) return;
+        add_queued(message.size());
+        if (kind == MessageKind::Status) queued_status_++;
+        queue_.push_back(Outbound{std::move(message), kind});
+        if (queued_bytes_ > limits_.high_water_bytes && !shed_load()) {
+            stopped_ = true;
+            slow_disconnects_.fetch_add(1, memory_order_relaxed);
+            cerr << "Session " << id_ << " disconnected: outbound queue over "
+                 << limits_.high_water_bytes << " bytes" << endl;
+            close();
+            return;
+        }
+        if (!writing_) {
+            writing_ = true;
+            kick = true;
+        }
+    }
+    if (kick) {
+        boost::asio::post(strand_, [self = shared_from_this()] { self->do_write(); });
+    }
+}
+
+bool Session::shed_load() {
+    if (limits_.policy != SlowReaderPolicy::DropStatus) return false;
+    // Chat first: losing a line of it costs nothing later. Status next, which
+    // a full snapshot repairs.
+    for (auto it = queue_.begin(); it != queue_.end() && queued_bytes_ > limits_.high_water_bytes;) {
+        if (it->kind != MessageKind::Chat) {
+            ++it;
+            continue;
+        }
+        remove_queued(it->data.size());
+        Metrics::add(Counter::ChatShed);
+        it = queue_.erase(it);
+    }
+    for (auto it = queue_.begin(); it != queue_.end() && queued_status_ > 0
+                                   && queued_bytes_ > limits_.high_water_bytes;) {
+        if (it->kind != MessageKind::Status) {
+            ++it;
+            continue;
+        }
+        remove_queued(it->data.size());
+        queued_status_--;
+        dropped_status_.fetch_add(1, memory_order_relaxed);
+        status_resync_ = true;
+        it = queue_.erase(it);
+    }
+    return queued_bytes_ <= limits_.high_water_bytes;
+}
+
+bool Session::take_status_resync() {
+    lock_guard<mutex> lock(queue_mutex_);
+    return exchange(status_resync_, false);
+}
+
+void Session::close() {
+    boost::asio::post(strand_, [self = shared_from_this()] {
+        self->finish();
+    });
+}
+
+void Session::handle_line(string_view line) {
+    Metrics::add(Counter::LinesReceived);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    try {
+        if (!line.empty() && on_line_) on_line_(line);
+    } catch (const std::exception& e) {
+        cerr << "Exception while handling client: " << e.what() << endl;
+    }
+}
+
+void Session::fail(const boost::system::error_code& ec, const char* what) {
+    if (ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted) {
+        cerr << "Session " << id_ << " " << what << " error: " << ec.message() << endl;
+    }
+    finish();
+}
+
+void Session::do_write() {
+    if (closed_) return;
+    {
+        // Take everything queued so far (up to kMaxGather messages) and send it
+        // with one gather write; the bytes stay counted until they are on the wire.
+        lock_guard<mutex> lock(queue_mutex_);
+        while (!queue_.empty() && in_flight_.size() < kMaxGather) {
+            if (queue_.front().kind == MessageKind::Status) queued_status_--;
+            in_flight_.push_back(std::move(queue_.front().data));
+            queue_.pop_front();
+        }
+        if (in_flight_.empty()) {
+            writing_ = false;
+            return;
+        }
+    }
+    if constexpr (kMetricsEnabled) write_started_ = chrono::steady_clock::now();
+    write_messages(in_flight_, [self = shared_from_this()](const boost::system::error_code& ec) {
+        if (ec || self->closed_) {
+            self->finish();
+            return;
+        }
+        size_t bytes = 0;
+        for (const auto& data : self->in_flight_) bytes += data.size();
+        if constexpr (kMetricsEnabled) {
+            Metrics::observe(Histogram::SocketWrite, chrono::steady_clock::now() - self->write_started_);
+            Metrics::add(Counter::SocketBytesWritten, bytes);
+        }
+        self->in_flight_.clear();
+        {
+            lock_guard<mutex> lock(self->queue_mutex_);
+            self->remove_queued(bytes);
+        }
+        self->do_write();
+    });
+}
+
+void Session::finish() {
+    if (closed_) return;
+    closed_ = true;
+    Metrics::gauge_add(Gauge::ActiveSessions, -1);
+    active_.fetch_sub(1, memory_order_relaxed);
+    {
+        lock_guard<mutex> lock(queue_mutex_);
+        stopped_ = true;  // refuse further deliveries
+        queue_.clear();
+        remove_queued(queued_bytes_);
+        queued_status_ = 0;
+    }
+    close_transport();
+    auto on_close = std::move(on_close_);
+    on_line_ = nullptr;
+    if (on_close) on_close();
+}
+
+TcpSession::TcpSession(tcp::socket socket, int id)
+    : Session(socket.get_executor(), id), socket_(std::move(socket)), buffer_(kMaxLineLength) {}
+
+void TcpSession::start_transport() { do_read(); }
+
+void TcpSession::do_read() {
+    boost::asio::async_read_until(socket_, buffer_, '\n',
+        [self = static_pointer_cast<TcpSession>(shared_from_this())](const boost::system::error_code& ec,
+                                                                     size_t length) {
+            if (ec) {
+                self->fail(ec, "read");
+                return;
+            }
+            // Hand the line to the handler straight out of the receive buffer;
+            // it is only consumed once the handler returns.
+            self->handle_line(string_view(static_cast<const char*>(self->buffer_.data().data()), length - 1));
+            self->buffer_.consume(length);
+            if (!self->closed()) self->do_read();
+        });
+}
+
+void TcpSession::write_messages(const vector<MessageBuffer>& messages, WriteHandler done) {
+    // One gather write for the whole batch.
+    vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(messages.size());
+    for (const auto& data : messages) buffers.push_back(boost::asio::buffer(data.data(), data.size()));
+    boost::asio::async_write(socket_, buffers,
+        [done = std::move(done)](const boost::system::error_code& ec, size_t) { done(ec); });
+}
+
+void TcpSession::close_transport() {
+    boost::system::error_code ignored;
+    socket_.shutdown(tcp::socket::shutdown_both, ignored);
+    socket_.close(ignored);
+}
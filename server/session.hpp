@@ -0,0 +1,173 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "message_buffer.hpp"
+
+// Status messages may be dropped for a slow reader, which is then resynced
+// with a full snapshot (see take_status_resync). Chat is shed first, under
+// overload or for a slow reader, and never resent. Everything else must
+// arrive in order.
+enum class MessageKind { Normal, Status, Chat };
+
+// What to do with a session whose unsent bytes pass the high-water mark.
+enum class SlowReaderPolicy {
+    DropStatus,  // drop queued chat, then status messages, oldest first; disconnect if still over
+    Disconnect,  // disconnect immediately
+};
+
+struct OutboundLimits {
+    std::size_t high_water_bytes = 256 * 1024;
+    SlowReaderPolicy policy = SlowReaderPolicy::DropStatus;
+};
+
+// Server-wide admission control (0 turns a limit off).
+struct AdmissionLimits {
+    // Off by default: the server sizes it from the open-file limit at startup
+    // (see main.cpp), since any fixed number would either turn away idle
+    // players it could hold or let accept() run into EMFILE.
+    std::size_t max_sessions = 0;
+    // Unsent bytes across all sessions past which the server counts as
+    // overloaded: chat is shed and new connections and room joins are refused.
+    std::size_t max_queued_bytes = 64 * 1024 * 1024;
+};
+
+// One connected client, independent of how it is connected. The outbound
+// queue, slow-reader policy and line dispatch live here; subclasses supply the
+// transport (raw TCP lines, WebSocket messages). All socket work for a session
+// runs on its own strand, so reads, writes and the line handler never race with
+// each other even though the io_context is shared by every worker thread.
+class Session : public std::enable_shared_from_this<Session> {
+public:
+    // The view is only valid for the duration of the call.
+    using LineHandler = std::function<void(std::string_view)>;
+    using CloseHandler = std::function<void()>;
+
+    // Longest line a client may send before the session is dropped.
+    static constexpr std::size_t kMaxLineLength = 4096;
+    // Most queued messages handed to a single gather write.
+    static constexpr std::size_t kMaxGather = 64;
+
+    Session(boost::asio::any_io_executor strand, int id);
+    virtual ~Session() = default;
+
+    // Applies to every session; call before the server starts accepting.
+    static void set_outbound_limits(const OutboundLimits& limits) { limits_ = limits; }
+    static void set_admission_limits(const AdmissionLimits& limits) { admission_ = limits; }
+
+    // True while new sessions should be turned away.
+    static bool full() {
+        return admission_.max_sessions && active_.load(std::memory_order_relaxed) >= admission_.max_sessions;
+    }
+    static bool overloaded() {
+        return admission_.max_queued_bytes
+               && total_queued_bytes_.load(std::memory_order_relaxed) > admission_.max_queued_bytes;
+    }
+    static std::size_t active_sessions() { return active_.load(std::memory_order_relaxed); }
+    static std::size_t total_queued_bytes() { return total_queued_bytes_.load(std::memory_order_relaxed); }
+
+    // Begins the read loop. on_line is called on the session strand for every
+    // complete line (without its line terminator), on_close exactly once when
+    // the connection goes away.
+    void start(LineHandler on_line, CloseHandler on_close);
+
+    // Queues a message for sending. Safe to call from any thread; costs one
+    // short lock and never waits on the socket. Fan-out callers should build
+    // the MessageBuffer once and hand the same one to every recipient.
+    void deliver(MessageBuffer message, MessageKind kind = MessageKind::Normal);
+    void deliver(std::string_view message, MessageKind kind = MessageKind::Normal) {
+        deliver(MessageBuffer::make(message), kind);
+    }
+
+    // Shuts the connection down from any thread.
+    void close();
+
+    int id() const { return id_; }
+
+    // True (once) if a status message was dropped from this session's queue
+    // since the last call, meaning its view needs a full snapshot.
+    bool take_status_resync();
+
+    static std::uint64_t dropped_status_messages() { return dropped_status_.load(std::memory_order_relaxed); }
+    static std::uint64_t slow_reader_disconnects() { return slow_disconnects_.load(std::memory_order_relaxed); }
+
+protected:
+    using WriteHandler = std::function<void(const boost::system::error_code&)>;
+
+    // Transport hooks, all called on the strand. start_transport() begins
+    // reading (after any handshake) and feeds lines to handle_line();
+    // write_messages() sends every message in order and then calls done once;
+    // close_transport() tears the connection down without waiting.
+    virtual void start_transport() = 0;
+    virtual void write_messages(const std::vector<MessageBuffer>& messages, WriteHandler done) = 0;
+    virtual void close_transport() = 0;
+
+    void handle_line(std::string_view line);
+    // For read or handshake failures; quiet about ordinary disconnects.
+    void fail(const boost::system::error_code& ec, const char* what);
+    bool closed() const { return closed_; }
+    void finish();
+
+private:
+    struct Outbound {
+        MessageBuffer data;
+        MessageKind kind;
+    };
+
+    void do_write();
+    // Called with queue_mutex_ held once queued_bytes_ passes the high-water mark.
+    bool shed_load();
+    // queued_bytes_ and the server-wide total move together.
+    void add_queued(std::size_t bytes);
+    void remove_queued(std::size_t bytes);
+
+    boost::asio::any_io_executor strand_;
+    int id_;
+    LineHandler on_line_;
+    CloseHandler on_close_;
+    bool closed_ = false;
+
+    std::mutex queue_mutex_;
+    std::deque<Outbound> queue_;
+    std::size_t queued_bytes_ = 0;
+    std::size_t queued_status_ = 0;
+    bool writing_ = false;
+    bool stopped_ = false;
+    bool status_resync_ = false;
+    std::vector<MessageBuffer> in_flight_;  // touched only on the strand
+    std::chrono::steady_clock::time_point write_started_;
+
+    static OutboundLimits limits_;
+    static AdmissionLimits admission_;
+    static std::atomic<std::size_t> active_;
+    static std::atomic<std::size_t> total_queued_bytes_;
+    static std::atomic<std::uint64_t> dropped_status_;
+    static std::atomic<std::uint64_t> slow_disconnects_;
+};
+
+// The original line protocol: newline-terminated text over a plain socket.
+class TcpSession : public Session {
+public:
+    TcpSession(boost::asio::ip::tcp::socket socket, int id);
+
+protected:
+    void start_transport() override;
+    void write_messages(const std::vector<MessageBuffer>& messages, WriteHandler done) override;
+    void close_transport() override;
+
+private:
+    void do_read();
+
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::streambuf buffer_;
+};
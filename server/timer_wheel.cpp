@@ -0,0 +1,144 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "metrics.hpp"
+
+using namespace std;
+
+TimerWheel::TimerWheel(boost::asio::io_context& io_context, chrono::milliseconds tick, size_t num_slots)
+    : strand_(boost::asio::make_strand(io_context)),
+      timer_(strand_),
+      tick_(max(tick, chrono::milliseconds(1))),
+      next_tick_(Clock::now() + tick_),
+      slots_(max<size_t>(num_slots, 1)) {}
+
+void TimerWheel::start() {
+    boost::asio::dispatch(strand_, [this] {
+        {
+            lock_guard<mutex> lock(mutex_);
+            running_ = true;
+        }
+        arm();
+    });
+}
+
+void TimerWheel::stop() {
+    boost::asio::dispatch(strand_, [this] {
+        {
+            lock_guard<mutex> lock(mutex_);
+            running_ = false;
+        }
+        timer_.cancel();
+    });
+}
+
+TimerWheel::TimerId TimerWheel::schedule(chrono::milliseconds delay, Callback callback) {
+    const auto deadline = Clock::now() + delay;
+    lock_guard<mutex> lock(mutex_);
+    return insert_locked(deadline, std::move(callback));
+}
+
+vector<TimerWheel::TimerId> TimerWheel::schedule_batch(chrono::milliseconds delay, vector<Callback> callbacks) {
+    const auto deadline = Clock::now() + delay;
+    vector<TimerId> ids;
+    ids.reserve(callbacks.size());
+    lock_guard<mutex> lock(mutex_);
+    for (auto& callback : callbacks) ids.push_back(insert_locked(deadline, std::move(callback)));
+    return ids;
+}
+
+TimerWheel::TimerId TimerWheel::insert_locked(Clock::time_point deadline, Callback callback) {
+    // Count ticks from the last processed one and round up, so a timer never
+    // fires early; it may fire up to one tick late.
+    const auto since_last_tick = deadline - (next_tick_ - tick_);
+    size_t ticks = static_cast<size_t>((since_last_tick + tick_ - Clock::duration(1)) / tick_);
+    ticks = max<size_t>(ticks, 1);
+    const TimerId id = next_id_++;
+    const size_t slot = (cursor_ + ticks) % slots_.size();
+    auto& list = slots_[slot];
+    auto it = list.insert(list.end(), Entry{id, (ticks - 1) / slots_.size(), deadline, std::move(callback)});
+    index_.emplace(id, make_pair(slot, it));
+    pending_.fetch_add(1, memory_order_relaxed);
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    Callback doomed;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto found = index_.find(id);
+        if (found == index_.end()) return false;
+        auto [slot, it] = found->second;
+        // Destroy the callback (and whatever it captured) outside the lock.
+        doomed = std::move(it->callback);
+        slots_[slot].erase(it);
+        index_.erase(found);
+        pending_.fetch_sub(1, memory_order_relaxed);
+    }
+    return true;
+}
+
+TimerWheel::LagStats TimerWheel::lag_stats() const {
+    lock_guard<mutex> lock(mutex_);
+    return lag_;
+}
+
+void TimerWheel::arm() {
+    Clock::time_point next;
+    {
+        lock_guard<mutex> lock(mutex_);
+        next = next_tick_;
+    }
+    timer_.expires_at(next);
+    timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted) return;
+        on_tick();
+    });
+}
+
+void TimerWheel::on_tick() {
+    vector<Entry> due;
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (!running_) return;
+        // Catch up on every tick we slept through so a stalled worker never
+        // skips a slot.
+        const auto now = Clock::now();
+        while (next_tick_ <= now) {
+            cursor_ = (cursor_ + 1) % slots_.size();
+            auto& list = slots_[cursor_];
+            for (auto it = list.begin(); it != list.end();) {
+                if (it->rounds > 0) {
+                    --it->rounds;
+                    ++it;
+                    continue;
+                }
+                index_.erase(it->id);
+                due.push_back(std::move(*it));
+                it = list.erase(it);
+            }
+            next_tick_ += tick_;
+        }
+        pending_.fetch_sub(due.size(), memory_order_relaxed);
+        for (const auto& entry : due) {
+            auto lag_us = static_cast<uint64_t>(
+                max<int64_t>(0, chrono::duration_cast<chrono::microseconds>(now - entry.deadline).count()));
+            lag_.fired++;
+            lag_.total_lag_us += lag_us;
+            lag_.max_lag_us = max(lag_.max_lag_us, lag_us);
+            Metrics::observe(Histogram::TimerLag, chrono::microseconds(lag_us));
+        }
+    }
+
+    // Fire the whole batch from this one handler, outside the wheel lock.
+    for (auto& entry : due) {
+        try {
+            entry.callback();
+        } catch (const std::exception& e) {
+            cerr << "Exception in timer callback: " << e.what() << endl;
+        }
+    }
+    arm();
+}
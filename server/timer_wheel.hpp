@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Hashed timer wheel driven by a single steady_timer. Thousands of pending
+// deadlines cost one list node each instead of one sleeping thread, cancel is
+// O(1), and every deadline that falls into the same tick is fired as one batch
+// from one handler.
+class TimerWheel {
+public:
+    using Callback = std::function<void()>;
+    using TimerId = std::uint64_t;
+    using Clock = std::chrono::steady_clock;
+
+    struct LagStats {
+        std::uint64_t fired = 0;
+        std::uint64_t total_lag_us = 0;
+        std::uint64_t max_lag_us = 0;
+    };
+
+    TimerWheel(boost::asio::io_context& io_context, std::chrono::milliseconds tick, std::size_t num_slots);
+
+    void start();
+    void stop();
+
+    // Safe from any thread. The returned id is never 0, so 0 can mean "no timer".
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+    // Schedules several timers with one deadline under a single lock, so they
+    // land in the same slot and fire in the same batch. Ids are in order.
+    std::vector<TimerId> schedule_batch(std::chrono::milliseconds delay, std::vector<Callback> callbacks);
+
+    // Returns false if the timer already fired (or is firing) or never existed.
+    bool cancel(TimerId id);
+
+    std::size_t pending() const { return pending_.load(std::memory_order_relaxed); }
+    LagStats lag_stats() const;
+
+private:
+    struct Entry {
+        TimerId id;
+        std::size_t rounds;
+        Clock::time_point deadline;
+        Callback callback;
+    };
+    using Slot = std::list<Entry>;
+
+    void arm();
+    void on_tick();
+    TimerId insert_locked(Clock::time_point deadline, Callback callback);
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::steady_timer timer_;
+    const std::chrono::milliseconds tick_;
+    Clock::time_point next_tick_;
+
+    mutable std::mutex mutex_;
+    std::vector<Slot> slots_;
+    std::unordered_map<TimerId, std::pair<std::size_t, Slot::iterator>> index_;
+    std::size_t cursor_ = 0;
+    TimerId next_id_ = 1;
+    std::atomic<std::size_t> pending_{0};
+    LagStats lag_;
+    bool running_ = false;
+};
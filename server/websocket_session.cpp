@@ -0,0 +1,109 @@
+#include "websocket_session.hpp"
+
+#include <string_view>
+#include <utility>
+
+using boost::asio::ip::tcp;
+namespace websocket = boost::beast::websocket;
+using namespace std;
+
+WebSocketSession::WebSocketSession(tcp::socket socket, int id)
+    : Session(socket.get_executor(), id), ws_(std::move(socket)) {
+    ws_.read_message_max(kMaxLineLength);
+    ws_.text(true);
+    // Pings keep idle browser tabs from being dropped by intermediaries; the
+    // handshake and close exchanges get bounded waits.
+    ws_.set_option(websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
+}
+
+void WebSocketSession::start_transport() {
+    ws_.async_accept([self = static_pointer_cast<WebSocketSession>(shared_from_this())](
+                         const boost::system::error_code& ec) {
+        if (ec) {
+            self->fail(ec, "handshake");
+            return;
+        }
+        self->open_ = true;
+        if (self->writing_) self->write_next_line();
+        self->do_read();
+    });
+}
+
+void WebSocketSession::do_read() {
+    ws_.async_read(buffer_,
+        [self = static_pointer_cast<WebSocketSession>(shared_from_this())](const boost::system::error_code& ec,
+                                                                           size_t) {
+            if (ec) {
+                // A clean close from the browser is an ordinary disconnect.
+                self->fail(ec == websocket::error::closed ? boost::asio::error::eof : ec, "read");
+                return;
+            }
+            // Split in place: one message usually holds exactly one line.
+            auto data = self->buffer_.cdata();
+            string_view rest(static_cast<const char*>(data.data()), data.size());
+            while (!rest.empty() && !self->closed()) {
+                size_t nl = rest.find('\n');
+                self->handle_line(rest.substr(0, nl));
+                rest.remove_prefix(nl == string_view::npos ? rest.size() : nl + 1);
+            }
+            self->buffer_.consume(self->buffer_.size());
+            if (!self->closed()) self->do_read();
+        });
+}
+
+void WebSocketSession::write_messages(const vector<MessageBuffer>& messages, WriteHandler done) {
+    // The base class keeps `messages` alive and untouched until done runs.
+    writing_ = &messages;
+    write_index_ = 0;
+    write_offset_ = 0;
+    write_done_ = std::move(done);
+    // The welcome message is queued before the upgrade completes; it goes out
+    // once the handshake is done.
+    if (open_) write_next_line();
+}
+
+void WebSocketSession::write_next_line() {
+    // Skip to the next non-empty line; the frames point straight into the
+    // shared MessageBuffers, so fan-out still copies nothing.
+    string_view line;
+    while (write_index_ < writing_->size()) {
+        string_view message = (*writing_)[write_index_].view();
+        if (write_offset_ >= message.size()) {
+            ++write_index_;
+            write_offset_ = 0;
+            continue;
+        }
+        string_view rest = message.substr(write_offset_);
+        size_t nl = rest.find('\n');
+        line = rest.substr(0, nl);
+        write_offset_ += nl == string_view::npos ? rest.size() : nl + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty()) break;
+    }
+    if (line.empty()) {
+        writing_ = nullptr;
+        auto done = std::move(write_done_);
+        done({});
+        return;
+    }
+    ws_.async_write(boost::asio::buffer(line.data(), line.size()),
+        [self = static_pointer_cast<WebSocketSession>(shared_from_this())](const boost::system::error_code& ec,
+                                                                           size_t) {
+            if (ec) {
+                self->writing_ = nullptr;
+                auto done = std::move(self->write_done_);
+                done(ec);
+                return;
+            }
+            self->write_next_line();
+        });
+}
+
+void WebSocketSession::close_transport() {
+    // No close handshake: finish() must not wait, and a dropped socket reads as
+    // an ordinary disconnect on the browser side.
+    boost::system::error_code ignored;
+    auto& socket = boost::beast::get_lowest_layer(ws_);
+    socket.shutdown(tcp::socket::shutdown_both, ignored);
+    socket.close(ignored);
+}
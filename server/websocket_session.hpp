@@ -0,0 +1,37 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "session.hpp"
+
+// A browser client speaking WebSocket directly, so index.html no longer needs
+// the Node proxy. Framing matches what the proxy did: every inbound text
+// message is a line (or several, newline-separated) and every outbound line
+// goes out as its own text message without the newline.
+class WebSocketSession : public Session {
+public:
+    WebSocketSession(boost::asio::ip::tcp::socket socket, int id);
+
+protected:
+    void start_transport() override;
+    void write_messages(const std::vector<MessageBuffer>& messages, WriteHandler done) override;
+    void close_transport() override;
+
+private:
+    void do_read();
+    void write_next_line();
+
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws_;
+    boost::beast::flat_buffer buffer_;
+    bool open_ = false;  // handshake done
+
+    // Progress through the batch handed to write_messages().
+    const std::vector<MessageBuffer>* writing_ = nullptr;
+    std::size_t write_index_ = 0;
+    std::size_t write_offset_ = 0;
+    WriteHandler write_done_;
+};
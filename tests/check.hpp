@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+
+// Just enough to write the tests in this directory without a framework: a
+// failing CHECK prints its location and the test's main returns failures().
+
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            check_failures()++;                                                  \
+        }                                                                        \
+    } while (0)
+
+inline int failures() {
+    if (check_failures()) std::fprintf(stderr, "%d check(s) failed\n", check_failures());
+    return check_failures() ? 1 : 0;
+}
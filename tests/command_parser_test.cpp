@@ -0,0 +1,45 @@
+// /login names: guests are called Player<number>, so no one may log in as one.
+
+#include <string>
+
+#include "../server/command_parser.hpp"
+#include "../server/player_store.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+namespace {
+
+bool logs_in(const string& line) {
+    Command cmd = parse_command(line);
+    return cmd.type == CommandType::Login;
+}
+
+void guest_names() {
+    for (int id : {1, 3, 42, 50000}) {
+        const string name = string(PlayerStore::kGuestPrefix) + to_string(id);
+        CHECK(PlayerStore::guest_name(name));
+        CHECK(!logs_in("/login " + name));
+    }
+    CHECK(!logs_in("/login Player007"));
+    CHECK(parse_command("/login Player3").type == CommandType::Invalid);
+}
+
+void other_names() {
+    CHECK(logs_in("/login alice"));
+    CHECK(logs_in("/login Player"));     // no number, never a guest
+    CHECK(logs_in("/login Player3x"));
+    CHECK(logs_in("/login player3"));    // names are case-sensitive
+    CHECK(logs_in("/login The_Player3"));
+    CHECK(!PlayerStore::guest_name("Player"));
+    CHECK(!PlayerStore::guest_name("Player-1"));
+    CHECK(parse_command("/login alice").text == "alice");
+}
+
+}  // namespace
+
+int main() {
+    guest_names();
+    other_names();
+    return failures();
+}
@@ -0,0 +1,73 @@
+// FlatIntMap against std::unordered_map under random inserts and erases. Small
+// key ranges keep the table crowded, so erase() keeps shifting long probe
+// runs back, including runs that wrap past the end of the array.
+
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+
+#include "../server/flat_int_map.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+namespace {
+
+bool same(const FlatIntMap<int>& map, const unordered_map<int, int>& expected, int key_range) {
+    if (map.size() != expected.size()) return false;
+    for (int key = 0; key < key_range; ++key) {
+        const int* found = map.find(key);
+        auto it = expected.find(key);
+        if ((found != nullptr) != (it != expected.end())) return false;
+        if (found && *found != it->second) return false;
+    }
+    size_t visited = 0;
+    map.for_each([&](int, int) { visited++; });
+    return visited == expected.size();
+}
+
+void random_ops(int key_range, int ops, uint32_t seed) {
+    mt19937 rng(seed);
+    FlatIntMap<int> map;
+    unordered_map<int, int> expected;
+    for (int op = 0; op < ops; ++op) {
+        const int key = static_cast<int>(rng() % key_range);
+        if (rng() % 2) {
+            const bool inserted = map.insert(key, op);
+            CHECK(inserted == expected.emplace(key, op).second);
+        } else {
+            CHECK(map.erase(key) == (expected.erase(key) == 1));
+        }
+        if (op % 64 == 0 && !same(map, expected, key_range)) {
+            CHECK(same(map, expected, key_range));
+            return;
+        }
+    }
+    CHECK(same(map, expected, key_range));
+}
+
+// Fill up to just below the growth threshold, then erase in an order that
+// empties the table from the middle of its probe runs.
+void erase_everything() {
+    FlatIntMap<int> map;
+    for (int key = 0; key < 11; ++key) CHECK(map.insert(key * 16, key));
+    for (int key = 1; key < 11; key += 2) CHECK(map.erase(key * 16));
+    for (int key = 0; key < 11; ++key) {
+        const int* found = map.find(key * 16);
+        CHECK((found != nullptr) == (key % 2 == 0));
+        if (found) CHECK(*found == key);
+    }
+    for (int key = 0; key < 11; key += 2) CHECK(map.erase(key * 16));
+    CHECK(map.empty());
+    CHECK(!map.erase(0));
+}
+
+}  // namespace
+
+int main() {
+    erase_everything();
+    random_ops(12, 20000, 1);     // never grows past 16 slots
+    random_ops(64, 200000, 2);
+    random_ops(4096, 50000, 3);
+    return failures();
+}
@@ -0,0 +1,124 @@
+// Match state after a challenge times out (settle_timeout), is called off, or
+// loses a player to a disconnect (abandon_match).
+
+#include "../server/match.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+static Player in_match_with(int id, int opponent, char move) {
+    Player p;
+    p.id = id;
+    p.in_match = true;
+    p.challenged_by = opponent;
+    p.pending_choice = move;
+    p.challenge_id = 7;
+    p.challenge_timer = 42;
+    return p;
+}
+
+static void check_released(const Player& p) {
+    CHECK(p.challenged_by == -1);
+    CHECK(p.pending_choice == '\0');
+    CHECK(p.challenge_timer == 0);
+}
+
+// An LMS timeout that kills the loser must still release them from the
+// challenge, or they can never be paired or challenged again.
+static void lms_timeout_kills() {
+    Player winner = in_match_with(1, 2, 'R');
+    Player loser = in_match_with(2, 1, '\0');
+    loser.hp = 1;
+    const ResultEffects effects = settle_timeout(true, RuleSet{}, winner, loser);
+    CHECK(effects.second_died);
+    CHECK(loser.hp == 0);
+    CHECK(loser.in_match);  // dead: nobody may challenge them
+    check_released(loser);
+    CHECK(!winner.in_match);
+    check_released(winner);
+    CHECK(winner.games_won == 1 && loser.num_games_played == 1);
+}
+
+static void lms_timeout_survives() {
+    Player winner = in_match_with(1, 2, 'P');
+    Player loser = in_match_with(2, 1, '\0');
+    const ResultEffects effects = settle_timeout(true, RuleSet{}, winner, loser);
+    CHECK(!effects.second_died);
+    CHECK(loser.hp == INITIAL_HP - 1);
+    CHECK(!loser.in_match);
+    check_released(loser);
+    check_released(winner);
+}
+
+static void deathmatch_timeout() {
+    Player winner = in_match_with(1, 2, 'S');
+    Player loser = in_match_with(2, 1, '\0');
+    loser.challenge_responded = true;
+    settle_timeout(false, RuleSet{}, winner, loser);
+    CHECK(loser.hp == INITIAL_HP);
+    CHECK(!loser.in_match && !winner.in_match);
+    CHECK(!loser.challenge_responded);
+    check_released(loser);
+    check_released(winner);
+    CHECK(winner.games_won == 1 && winner.num_games_played == 1);
+}
+
+static void no_contest() {
+    Player a = in_match_with(1, 2, '\0');
+    Player b = in_match_with(2, 1, '\0');
+    end_match(a);
+    end_match(b);
+    CHECK(!a.in_match && !b.in_match);
+    check_released(a);
+    check_released(b);
+    CHECK(a.num_games_played == 0);
+}
+
+// A disconnect mid-challenge calls the match off: no result for anyone, and
+// the opponent is free to play again.
+static void opponent_disconnects() {
+    Player gone = in_match_with(1, 2, 'R');
+    Player other = in_match_with(2, 1, '\0');
+    other.challenge_responded = true;
+    CHECK(abandon_match(gone, other));
+    CHECK(!other.in_match && !gone.in_match);
+    CHECK(!other.challenge_responded);
+    check_released(other);
+    check_released(gone);
+    CHECK(other.num_games_played == 0 && other.hp == INITIAL_HP);
+    CHECK(gone.games_won == 0);
+}
+
+// Only the match between the two is touched: not one the opponent has moved
+// on to, and not a dead LMS player who is merely kept out of challenges.
+static void abandon_leaves_other_matches() {
+    Player gone = in_match_with(1, 2, 'R');
+    Player other = in_match_with(2, 3, 'P');
+    CHECK(!abandon_match(gone, other));
+    CHECK(other.in_match && other.challenged_by == 3 && other.pending_choice == 'P');
+
+    Player stale = in_match_with(1, 2, 'R');
+    Player rematched = in_match_with(2, 1, '\0');
+    rematched.challenge_id = 8;
+    CHECK(!abandon_match(stale, rematched));
+    CHECK(rematched.in_match && rematched.challenge_timer == 42);
+
+    Player dead;
+    dead.id = 2;
+    dead.in_match = true;
+    dead.hp = 0;
+    Player leaver;
+    leaver.id = 1;
+    CHECK(!abandon_match(leaver, dead));
+    CHECK(dead.in_match);
+}
+
+int main() {
+    lms_timeout_kills();
+    lms_timeout_survives();
+    deathmatch_timeout();
+    no_contest();
+    opponent_disconnects();
+    abandon_leaves_other_matches();
+    return failures();
+}
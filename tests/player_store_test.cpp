@@ -0,0 +1,192 @@
+// PlayerStore recovery: a torn log tail, a log and snapshot from different
+// compactions, and a compaction that fails part way.
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "../server/player_store.hpp"
+#include "check.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+// A fresh directory under the system temp directory, removed at exit.
+struct TempDir {
+    fs::path path;
+    TempDir() {
+        string templ = (fs::temp_directory_path() / "player_store_test.XXXXXX").string();
+        if (mkdtemp(templ.data())) path = templ;
+    }
+    ~TempDir() {
+        error_code ec;
+        fs::remove_all(path, ec);
+    }
+};
+
+const auto kFlush = chrono::milliseconds(5);
+
+PlayerStore::Stats stats(int n) { return PlayerStore::Stats{n, n / 2, 5, n % 3}; }
+
+bool loads(PlayerStore& store, const string& name, int n) {
+    PlayerStore::Stats out;
+    return store.load(name, out) && out.games_played == n && out.games_won == n / 2;
+}
+
+bool open(PlayerStore& store) {
+    string error;
+    return store.open(error);
+}
+
+// Saves player0..player<n-1> and waits until they are all in the log, which
+// is never compacted; copies it to `log_copy` before stop() compacts it away.
+void write_log(const fs::path& dir, int n, const fs::path& log_copy) {
+    PlayerStore store(dir.string(), kFlush, SIZE_MAX);
+    CHECK(open(store));
+    store.start();
+    for (int i = 0; i < n; ++i) store.save("player" + to_string(i), stats(i));
+    while (store.counters().log_records < static_cast<uint64_t>(n)) this_thread::sleep_for(kFlush);
+    fs::copy_file(dir / "players.log", log_copy);
+}
+
+void append_bytes(const fs::path& file, size_t n) {
+    ofstream(file, ios::binary | ios::app) << string(n, '\x5a');
+}
+
+void flip_byte(const fs::path& file, uintmax_t offset) {
+    fstream f(file, ios::binary | ios::in | ios::out);
+    f.seekg(static_cast<streamoff>(offset));
+    char c = static_cast<char>(f.get());
+    f.seekp(static_cast<streamoff>(offset));
+    f.put(static_cast<char>(c ^ 0x01));
+}
+
+void round_trip() {
+    TempDir dir;
+    {
+        PlayerStore store(dir.path.string(), kFlush);
+        CHECK(open(store));
+        store.start();
+        for (int i = 0; i < 100; ++i) store.save("player" + to_string(i), stats(i));
+        store.save("player7", stats(70));
+        CHECK(loads(store, "player7", 70));  // still queued or in flight
+    }
+    PlayerStore store(dir.path.string());
+    CHECK(open(store));
+    CHECK(store.counters().snapshot_records == 100);
+    CHECK(store.counters().log_records == 0);
+    CHECK(loads(store, "player0", 0));
+    CHECK(loads(store, "player99", 99));
+    CHECK(loads(store, "player7", 70));
+    CHECK(!loads(store, "player100", 100));
+}
+
+// A crash mid-append leaves a partial entry, or one whose checksum fails;
+// open() replays everything before it and cuts the log back to there.
+void torn_tail() {
+    TempDir scratch, dir;
+    write_log(scratch.path, 3, dir.path / "players.log");
+    const fs::path log = dir.path / "players.log";
+    const uintmax_t whole = fs::file_size(log);
+
+    append_bytes(log, 20);
+    {
+        PlayerStore store(dir.path.string());
+        CHECK(open(store));
+        CHECK(store.counters().log_records == 3);
+        CHECK(loads(store, "player2", 2));
+    }
+    CHECK(fs::file_size(log) == whole);
+
+    // The last entry ends in its checksum and 4 reserved bytes, so 20 bytes
+    // from the end is inside its record.
+    flip_byte(log, whole - 20);
+    PlayerStore store(dir.path.string());
+    CHECK(open(store));
+    CHECK(store.counters().log_records == 2);
+    CHECK(loads(store, "player1", 1));
+    CHECK(!loads(store, "player2", 2));
+    CHECK(fs::file_size(log) < whole);
+}
+
+void generation_mismatch() {
+    TempDir dir, old_log;
+    write_log(dir.path, 3, old_log.path / "players.log");
+    // The store above compacted on exit: the snapshot is one generation on
+    // and the log was reset to match it.
+    const fs::path log = dir.path / "players.log";
+    const uintmax_t empty_log = fs::file_size(log);
+
+    // A log older than the snapshot was already folded into it, by a
+    // compaction that crashed before resetting the log.
+    fs::copy_file(old_log.path / "players.log", log, fs::copy_options::overwrite_existing);
+    {
+        PlayerStore store(dir.path.string());
+        CHECK(open(store));
+        CHECK(store.counters().snapshot_records == 3);
+        CHECK(store.counters().log_records == 0);
+        CHECK(loads(store, "player2", 2));
+    }
+    CHECK(fs::file_size(log) == empty_log);
+
+    // A log newer than the snapshot means the snapshot was swapped for an
+    // older one; refuse to open rather than lose the log's saves.
+    fs::remove(dir.path / "players.snap");
+    PlayerStore store(dir.path.string());
+    string error;
+    CHECK(!store.open(error));
+    CHECK(error.find("newer than the snapshot") != string::npos);
+    CHECK(fs::file_size(log) == empty_log);
+}
+
+// A failed compaction keeps serving the saves from memory, leaves the log
+// alone and tries again next time.
+void failed_compaction() {
+    TempDir dir;
+    // Nothing can be created where the temporary snapshot goes.
+    fs::create_directory(dir.path / "players.snap.tmp");
+    {
+        PlayerStore store(dir.path.string(), kFlush, 2);
+        CHECK(open(store));
+        store.start();
+        for (int i = 0; i < 5; ++i) store.save("player" + to_string(i), stats(i));
+        while (store.counters().records_written < 5) this_thread::sleep_for(kFlush);
+        store.stop();
+        CHECK(store.counters().compactions == 0);
+        CHECK(store.counters().snapshot_records == 0);
+        CHECK(loads(store, "player0", 0));
+        CHECK(loads(store, "player4", 4));
+    }
+    CHECK(!fs::exists(dir.path / "players.snap"));
+
+    fs::remove(dir.path / "players.snap.tmp");
+    {
+        PlayerStore store(dir.path.string());
+        CHECK(open(store));
+        CHECK(store.counters().log_records == 5);
+        CHECK(loads(store, "player4", 4));
+        store.start();
+    }
+    PlayerStore store(dir.path.string());
+    CHECK(open(store));
+    CHECK(store.counters().snapshot_records == 5);
+    CHECK(loads(store, "player3", 3));
+}
+
+}  // namespace
+
+int main() {
+    round_trip();
+    torn_tail();
+    generation_mismatch();
+    failed_compaction();
+    return failures();
+}
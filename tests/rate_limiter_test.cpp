@@ -0,0 +1,60 @@
+// RateLimiter: per-class buckets inside one bucket for every line.
+
+#include "../server/rate_limiter.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+namespace {
+
+using Clock = TokenBucket::Clock;
+
+// A line the line bucket refuses must not also use up its class token.
+void refused_line_keeps_class_token() {
+    RateLimits limits;
+    limits.lines = Rate{1, 2};
+    limits.classes[static_cast<size_t>(CommandClass::Game)] = Rate{0.5, 3};
+    RateLimiter::set_limits(limits);
+    RateLimiter limiter;
+    const auto now = Clock::now();
+    CHECK(limiter.allow(CommandClass::Game, now));
+    CHECK(limiter.allow(CommandClass::Game, now));
+    CHECK(!limiter.allow(CommandClass::Game, now));  // lines empty, class has 1 left
+    CHECK(!limiter.allow(CommandClass::Game, now));
+    // One second refills one line token but only half a class token, so this
+    // passes only if the class kept its last one.
+    CHECK(limiter.allow(CommandClass::Game, now + chrono::seconds(1)));
+}
+
+// A flood of one class runs dry without touching the line budget.
+void class_limit_spares_lines() {
+    RateLimits limits;
+    limits.lines = Rate{1, 3};
+    limits.classes[static_cast<size_t>(CommandClass::Chat)] = Rate{1, 1};
+    limits.classes[static_cast<size_t>(CommandClass::Game)] = Rate{1, 2};
+    RateLimiter::set_limits(limits);
+    RateLimiter limiter;
+    const auto now = Clock::now();
+    CHECK(limiter.allow(CommandClass::Chat, now));
+    for (int i = 0; i < 10; ++i) CHECK(!limiter.allow(CommandClass::Chat, now));
+    CHECK(limiter.allow(CommandClass::Game, now));
+    CHECK(limiter.allow(CommandClass::Game, now));
+}
+
+void warning_once_per_run() {
+    RateLimiter::set_limits(RateLimits{});
+    RateLimiter limiter;
+    CHECK(limiter.take_warning());
+    CHECK(!limiter.take_warning());
+    CHECK(limiter.allow(CommandClass::Query));
+    CHECK(limiter.take_warning());
+}
+
+}  // namespace
+
+int main() {
+    refused_line_keeps_class_token();
+    class_limit_spares_lines();
+    warning_once_per_run();
+    return failures();
+}
@@ -0,0 +1,182 @@
+// The rules engine on its own (server/rules.cpp) and against the Player-level
+// code the server runs on /move and on a timeout (server/match.cpp).
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "../server/match.hpp"
+#include "../server/rules.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+namespace {
+
+Standing standing_of(const Player& p) { return Standing{p.hp, p.current_winstreak, p.num_games_played, p.games_won}; }
+
+bool same(const Standing& a, const Standing& b) {
+    return a.hp == b.hp && a.winstreak == b.winstreak && a.games_played == b.games_played && a.games_won == b.games_won;
+}
+
+Player player_with(int id, const Standing& s) {
+    Player p;
+    p.id = id;
+    p.hp = s.hp;
+    p.current_winstreak = s.winstreak;
+    p.num_games_played = s.games_played;
+    p.games_won = s.games_won;
+    return p;
+}
+
+// Rock beats scissors, paper beats rock, scissors beat paper; same moves tie.
+void move_table() {
+    const char moves[] = {'R', 'P', 'S'};
+    const Outcome expected[3][3] = {
+        {Outcome::Draw, Outcome::SecondWins, Outcome::FirstWins},
+        {Outcome::FirstWins, Outcome::Draw, Outcome::SecondWins},
+        {Outcome::SecondWins, Outcome::FirstWins, Outcome::Draw},
+    };
+    for (int a = 0; a < 3; ++a) {
+        CHECK(move_index(moves[a]) == a);
+        CHECK(move_char(a) == moves[a]);
+        for (int b = 0; b < 3; ++b) CHECK(resolve(moves[a], moves[b]) == expected[a][b]);
+    }
+    CHECK(move_index('x') == -1);
+}
+
+// Every throw, in batches that use the SSE2 path and the scalar tail, with
+// the unused lanes zeroed the way tournament_sim parks finished games.
+void batch_matches_scalar() {
+    mt19937 rng(7);
+    for (size_t n : {1u, 15u, 16u, 17u, 64u, 1000u}) {
+        vector<uint8_t> first(n), second(n);
+        vector<char> active(n);
+        for (size_t i = 0; i < n; ++i) {
+            active[i] = rng() % 4 != 0;
+            first[i] = active[i] ? static_cast<uint8_t>(rng() % 3) : 0;
+            second[i] = active[i] ? static_cast<uint8_t>(rng() % 3) : 0;
+        }
+        vector<Outcome> out(n);
+        resolve_batch(first.data(), second.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i) {
+            CHECK(out[i] == resolve(move_char(first[i]), move_char(second[i])));
+            if (!active[i]) CHECK(out[i] == Outcome::Draw);
+        }
+    }
+}
+
+void lms_elimination() {
+    const RuleSet rules;
+    Standing a, b{1, 2, 4, 2};
+    ResultEffects effects = apply_result(true, rules, Outcome::FirstWins, a, b);
+    CHECK(!effects.first_died && effects.second_died && !effects.spree);
+    CHECK(b.hp == 0 && b.winstreak == 0 && b.games_played == 5);
+    CHECK(a.hp == INITIAL_HP && a.winstreak == 1 && a.games_won == 1);
+
+    // The first player can die too.
+    Standing c{1, 0, 0, 0}, d;
+    effects = apply_result(true, rules, Outcome::SecondWins, c, d);
+    CHECK(effects.first_died && !effects.second_died);
+    CHECK(c.hp == 0 && d.games_won == 1);
+
+    // A draw costs nothing but both streaks.
+    Standing e{3, 2, 0, 0}, f{3, 1, 0, 0};
+    effects = apply_result(true, rules, Outcome::Draw, e, f);
+    CHECK(!effects.first_died && !effects.second_died);
+    CHECK(e.hp == 3 && f.hp == 3 && e.winstreak == 0 && f.winstreak == 0);
+    CHECK(e.games_played == 1 && e.games_won == 0);
+
+    // The spree_length-th win in a row heals and starts a new streak.
+    Standing g{2, rules.spree_length - 1, 0, 0}, h;
+    effects = apply_result(true, rules, Outcome::FirstWins, g, h);
+    CHECK(effects.spree);
+    CHECK(g.hp == 2 + rules.spree_heal && g.winstreak == 0);
+
+    // Three seats: the game ends at the second death, not the first.
+    PlayerTable table;
+    table.assign(3, rules);
+    table.hp = {1, 1, 2};
+    Standing s0 = table.get(0), s2 = table.get(2);
+    apply_result(true, rules, Outcome::SecondWins, s0, s2);
+    table.set(0, s0);
+    table.set(2, s2);
+    CHECK(table.alive(0, 3) == 2 && !lms_game_over(table.alive(0, 3)));
+    Standing s1 = table.get(1);
+    s2 = table.get(2);
+    apply_result(true, rules, Outcome::SecondWins, s1, s2);
+    table.set(1, s1);
+    table.set(2, s2);
+    CHECK(lms_game_over(table.alive(0, 3)));
+}
+
+// Deathmatch counts games and wins only; nobody loses HP or keeps a streak.
+void deathmatch_scoring() {
+    const RuleSet rules;
+    Standing a, b;
+    for (Outcome o : {Outcome::FirstWins, Outcome::FirstWins, Outcome::SecondWins, Outcome::Draw}) {
+        const ResultEffects effects = apply_result(false, rules, o, a, b);
+        CHECK(!effects.first_died && !effects.second_died && !effects.spree);
+    }
+    CHECK(a.games_played == 4 && a.games_won == 2);
+    CHECK(b.games_played == 4 && b.games_won == 1);
+    CHECK(a.hp == INITIAL_HP && b.hp == INITIAL_HP);
+    CHECK(a.winstreak == 0 && b.winstreak == 0);
+}
+
+// The server's Player-level calls must give exactly what the engine gives
+// for the same standings, in both modes and for every outcome.
+void agrees_with_match() {
+    mt19937 rng(11);
+    RuleSet rules;
+    rules.initial_hp = 3;
+    for (int round = 0; round < 2000; ++round) {
+        const bool lms = rng() % 2;
+        const Outcome outcome = static_cast<Outcome>(rng() % 3);
+        Standing a{static_cast<int>(rng() % 4) + 1, static_cast<int>(rng() % 3), static_cast<int>(rng() % 50), 0};
+        Standing b{static_cast<int>(rng() % 4) + 1, static_cast<int>(rng() % 3), static_cast<int>(rng() % 50), 0};
+        a.games_won = a.games_played / 2;
+        b.games_won = b.games_played / 3;
+
+        Player pa = player_with(1, a), pb = player_with(2, b);
+        const ResultEffects on_players = apply_result(lms, rules, outcome, pa, pb);
+        const ResultEffects on_standings = apply_result(lms, rules, outcome, a, b);
+        CHECK(same(standing_of(pa), a) && same(standing_of(pb), b));
+        CHECK(on_players.spree == on_standings.spree && on_players.first_died == on_standings.first_died
+              && on_players.second_died == on_standings.second_died);
+    }
+}
+
+// A timeout is scored as the side that moved winning the throw.
+void timeout_forfeits() {
+    const RuleSet rules;
+    for (bool lms : {true, false}) {
+        for (int loser_hp : {1, 2, INITIAL_HP}) {
+            Standing winner{INITIAL_HP, rules.spree_length - 1, 3, 2}, loser{loser_hp, 1, 3, 1};
+            Player pw = player_with(1, winner), pl = player_with(2, loser);
+            pw.in_match = pl.in_match = true;
+            pw.challenged_by = 2;
+            pl.challenged_by = 1;
+            pw.pending_choice = 'R';
+
+            const ResultEffects by_timeout = settle_timeout(lms, rules, pw, pl);
+            const ResultEffects by_throw = apply_result(lms, rules, Outcome::FirstWins, winner, loser);
+            CHECK(same(standing_of(pw), winner) && same(standing_of(pl), loser));
+            CHECK(by_timeout.spree == by_throw.spree && by_timeout.second_died == by_throw.second_died);
+            CHECK(pl.in_match == (lms && loser.hp <= 0));
+            CHECK(!pw.in_match && pw.challenged_by == -1 && pl.challenged_by == -1);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    move_table();
+    batch_matches_scalar();
+    lms_elimination();
+    deathmatch_scoring();
+    agrees_with_match();
+    timeout_forfeits();
+    return failures();
+}
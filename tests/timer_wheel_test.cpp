@@ -0,0 +1,91 @@
+// TimerWheel deadlines around and past one turn of the wheel, where `rounds`
+// decides whether a timer in the current slot is due now or a turn later.
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../server/timer_wheel.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+namespace {
+
+using Clock = TimerWheel::Clock;
+
+constexpr auto kTick = chrono::milliseconds(20);
+constexpr size_t kSlots = 4;
+constexpr auto kTurn = kTick * kSlots;
+
+struct Fired {
+    mutex m;
+    vector<Clock::time_point> at;
+};
+
+void deadlines() {
+    boost::asio::io_context io_context;
+    auto guard = boost::asio::make_work_guard(io_context);
+    thread runner([&] { io_context.run(); });
+    TimerWheel wheel(io_context, kTick, kSlots);
+    wheel.start();
+
+    // In ticks: within the first turn, exactly one turn (the current slot with
+    // no rounds left), just past it, and several turns out.
+    const vector<chrono::milliseconds> delays = {
+        kTick, kTick * 3, kTurn - chrono::milliseconds(1), kTurn, kTurn + chrono::milliseconds(1),
+        kTurn * 2, kTurn * 2 + kTick, kTurn * 3 + kTick * 3,
+    };
+    Fired fired;
+    fired.at.resize(delays.size());
+    vector<Clock::time_point> scheduled(delays.size());
+    for (size_t i = 0; i < delays.size(); ++i) {
+        scheduled[i] = Clock::now();
+        wheel.schedule(delays[i], [&fired, i] {
+            lock_guard<mutex> lock(fired.m);
+            fired.at[i] = Clock::now();
+        });
+    }
+    const auto cancelled = wheel.schedule(kTurn + kTick, [&fired] {
+        lock_guard<mutex> lock(fired.m);
+        fired.at.push_back(Clock::now());
+    });
+    CHECK(wheel.cancel(cancelled));
+    CHECK(!wheel.cancel(cancelled));
+
+    while (wheel.pending() > 0) this_thread::sleep_for(kTick);
+    wheel.stop();
+    guard.reset();
+    runner.join();
+
+    lock_guard<mutex> lock(fired.m);
+    CHECK(fired.at.size() == delays.size());
+    for (size_t i = 0; i < delays.size(); ++i) {
+        const auto elapsed = fired.at[i] - scheduled[i];
+        // Never early, and never a whole turn late, which is what an
+        // off-by-one in `rounds` would do.
+        CHECK(elapsed >= delays[i]);
+        CHECK(elapsed < delays[i] + kTurn);
+    }
+    CHECK(wheel.lag_stats().fired == delays.size());
+}
+
+void batch_ids() {
+    boost::asio::io_context io_context;
+    TimerWheel wheel(io_context, kTick, kSlots);
+    auto ids = wheel.schedule_batch(kTurn * 2, vector<TimerWheel::Callback>(3, [] {}));
+    CHECK(ids.size() == 3);
+    CHECK(ids[0] != 0 && ids[0] < ids[1] && ids[1] < ids[2]);
+    CHECK(wheel.pending() == 3);
+    for (auto id : ids) CHECK(wheel.cancel(id));
+    CHECK(wheel.pending() == 0);
+}
+
+}  // namespace
+
+int main() {
+    deadlines();
+    batch_ids();
+    return failures();
+}